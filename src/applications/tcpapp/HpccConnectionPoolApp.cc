@@ -0,0 +1,298 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include <algorithm>
+#include <inet/applications/tcpapp/GenericAppMsg_m.h>
+#include <inet/common/TimeTag_m.h>
+#include <inet/common/packet/Packet.h>
+#include <inet/networklayer/common/L3AddressResolver.h>
+
+#include "HpccConnectionPoolApp.h"
+
+namespace inet {
+
+Define_Module(HpccConnectionPoolApp);
+
+simsignal_t HpccConnectionPoolApp::messageLatencySignal = registerSignal("messageLatency");
+simsignal_t HpccConnectionPoolApp::outstandingLengthSignal = registerSignal("outstandingLength");
+
+HpccConnectionPoolApp::~HpccConnectionPoolApp()
+{
+    cancelAndDelete(messageTimer);
+    socketMap.deleteSockets();
+}
+
+void HpccConnectionPoolApp::initialize(int stage)
+{
+    ApplicationBase::initialize(stage);
+    if (stage == INITSTAGE_LOCAL) {
+        const char *schedulerString = par("scheduler");
+        if (!strcmp(schedulerString, "roundRobin"))
+            scheduler = ROUND_ROBIN;
+        else if (!strcmp(schedulerString, "leastOutstanding"))
+            scheduler = LEAST_OUTSTANDING;
+        else
+            throw cRuntimeError("Unknown scheduler '%s', must be 'roundRobin' or 'leastOutstanding'", schedulerString);
+        poolSize = par("poolSize");
+        connectPort = par("connectPort");
+        replyLength = B(par("replyLength").intValue());
+        startTime = par("startTime");
+        stopTime = par("stopTime");
+        numMessages = par("numMessages");
+        maxOutstandingMessages = par("maxOutstandingMessages");
+        // with zero sendInterval the pool keeps maxOutstandingMessages outstanding instead of generating messages on a timer
+        backlogged = par("sendInterval").doubleValue() == 0;
+        if (backlogged && maxOutstandingMessages < 0)
+            throw cRuntimeError("A backlogged pool (sendInterval = 0) needs a maxOutstandingMessages limit");
+        if (poolSize < 1)
+            throw cRuntimeError("poolSize must be at least 1");
+        if (replyLength < B(1))
+            throw cRuntimeError("replyLength must be positive, the replies acknowledge the messages");
+        if (stopTime >= SIMTIME_ZERO && stopTime < startTime)
+            throw cRuntimeError("Invalid startTime/stopTime parameters");
+        messageTimer = new cMessage("message");
+        WATCH(numOutstandingMessages);
+        WATCH(numMessagesGenerated);
+    }
+}
+
+void HpccConnectionPoolApp::handleStartOperation(LifecycleOperation *operation)
+{
+    simtime_t start = std::max(startTime, simTime());
+    if (stopTime < SIMTIME_ZERO || start < stopTime)
+        scheduleAt(start, messageTimer);
+}
+
+void HpccConnectionPoolApp::handleStopOperation(LifecycleOperation *operation)
+{
+    cancelEvent(messageTimer);
+    for (auto& connection : connections)
+        connection.socket->close();
+    delayActiveOperationFinish(par("stopOperationTimeout"));
+}
+
+void HpccConnectionPoolApp::handleCrashOperation(LifecycleOperation *operation)
+{
+    cancelEvent(messageTimer);
+    for (auto& connection : connections)
+        connection.socket->destroy();
+    socketMap.deleteSockets();
+    connections.clear();
+    queuedMessages.clear();
+    numEstablished = 0;
+    numOutstandingMessages = 0;
+}
+
+void HpccConnectionPoolApp::handleMessageWhenUp(cMessage *msg)
+{
+    if (msg == messageTimer) {
+        if (connections.empty())
+            connect();
+        else {
+            generateMessage();
+            sendMessages();
+            if (!backlogged) {
+                simtime_t next = simTime() + par("sendInterval");
+                if (canGenerateMessage() && (stopTime < SIMTIME_ZERO || next < stopTime))
+                    scheduleAt(next, messageTimer);
+            }
+        }
+    }
+    else {
+        TcpSocket *socket = check_and_cast_nullable<TcpSocket *>(socketMap.findSocketFor(msg));
+        if (socket != nullptr)
+            socket->processMessage(msg);
+        else {
+            EV_WARN << "Message " << msg->getName() << " arrived for an unknown socket, dropping it.\n";
+            delete msg;
+        }
+    }
+}
+
+void HpccConnectionPoolApp::connect()
+{
+    std::vector<std::string> connectAddresses = cStringTokenizer(par("connectAddresses")).asVector();
+    if (connectAddresses.empty())
+        throw cRuntimeError("connectAddresses is empty");
+    // the pool is ordered connection by connection, so round robin alternates servers before reusing one
+    connections.resize(poolSize * connectAddresses.size());
+    for (size_t i = 0; i < connections.size(); i++) {
+        TcpSocket *socket = new TcpSocket();
+        socket->setOutputGate(gate("socketOut"));
+        socket->setCallback(this);
+        socket->bind(L3Address(), -1);
+        socket->connect(L3AddressResolver().resolve(connectAddresses[i % connectAddresses.size()].c_str()), connectPort);
+        socketMap.addSocket(socket);
+        connections[i].socket = socket;
+    }
+    EV_INFO << "Opening a pool of " << connections.size() << " connections.\n";
+}
+
+void HpccConnectionPoolApp::socketEstablished(TcpSocket *socket)
+{
+    // messages are generated as soon as the first connection is open, selectConnection() skips the ones that are
+    // not (or never will be, if their setup fails), and later ones take their share from the next message on
+    if (numEstablished++ == 0)
+        scheduleAt(simTime(), messageTimer);
+    else
+        sendMessages();
+}
+
+bool HpccConnectionPoolApp::canGenerateMessage() const
+{
+    return numMessages < 0 || numMessagesGenerated < numMessages;
+}
+
+void HpccConnectionPoolApp::generateMessage()
+{
+    if (backlogged || !canGenerateMessage())
+        return;
+    queuedMessages.push_back(B(par("messageLength").intValue()));
+    numMessagesGenerated++;
+}
+
+void HpccConnectionPoolApp::sendMessages()
+{
+    bool generate = backlogged && (stopTime < SIMTIME_ZERO || simTime() < stopTime);
+    while (maxOutstandingMessages < 0 || numOutstandingMessages < maxOutstandingMessages) {
+        if (queuedMessages.empty()) {
+            if (!generate || !canGenerateMessage())
+                break;
+            queuedMessages.push_back(B(par("messageLength").intValue()));
+            numMessagesGenerated++;
+        }
+        Connection *connection = selectConnection();
+        if (connection == nullptr)
+            break;
+        sendMessage(*connection, queuedMessages.front());
+        queuedMessages.pop_front();
+    }
+}
+
+HpccConnectionPoolApp::Connection *HpccConnectionPoolApp::selectConnection()
+{
+    Connection *selected = nullptr;
+    int numConnections = connections.size();
+    for (int i = 0; i < numConnections; i++) {
+        Connection& connection = connections[(nextConnection + i) % numConnections];
+        if (connection.socket->getState() != TcpSocket::CONNECTED)
+            continue;
+        if (scheduler == ROUND_ROBIN) {
+            nextConnection = (nextConnection + i + 1) % numConnections;
+            return &connection;
+        }
+        // ties go to the first connection after the last one used
+        if (selected == nullptr || connection.outstandingLength < selected->outstandingLength)
+            selected = &connection;
+    }
+    if (selected != nullptr)
+        nextConnection = (selected - connections.data() + 1) % numConnections;
+    return selected;
+}
+
+void HpccConnectionPoolApp::sendMessage(Connection& connection, B length)
+{
+    const auto& message = makeShared<GenericAppMsg>();
+    message->setChunkLength(length);
+    message->setExpectedReplyLength(replyLength);
+    message->setServerClose(false);
+    message->addTag<CreationTimeTag>()->setCreationTime(simTime());
+    Packet *packet = new Packet("message");
+    packet->insertAtBack(message);
+    connection.socket->send(packet);
+    connection.inFlight.push_back(Message{simTime(), length, replyLength});
+    connection.outstandingLength += length;
+    connection.bytesSent += length.get();
+    numOutstandingMessages++;
+    if (firstSendTime < SIMTIME_ZERO)
+        firstSendTime = simTime();
+}
+
+HpccConnectionPoolApp::Connection& HpccConnectionPoolApp::getConnection(TcpSocket *socket)
+{
+    for (auto& connection : connections)
+        if (connection.socket == socket)
+            return connection;
+    throw cRuntimeError("Socket %d is not in the pool", socket->getSocketId());
+}
+
+void HpccConnectionPoolApp::socketDataArrived(TcpSocket *socket, Packet *packet, bool urgent)
+{
+    Connection& connection = getConnection(socket);
+    B length = B(packet->getByteLength());
+    delete packet;
+    // replies arrive in order, a segment may complete several of them
+    while (length > B(0) && !connection.inFlight.empty()) {
+        Message& message = connection.inFlight.front();
+        B consumed = std::min(length, message.remainingReplyLength);
+        message.remainingReplyLength -= consumed;
+        length -= consumed;
+        if (message.remainingReplyLength == B(0)) {
+            emit(messageLatencySignal, simTime() - message.sendTime);
+            connection.outstandingLength -= message.length;
+            connection.bytesCompleted += message.length.get();
+            connection.numMessages++;
+            numOutstandingMessages--;
+            lastCompletionTime = simTime();
+            connection.inFlight.pop_front();
+        }
+    }
+    emit(outstandingLengthSignal, connection.outstandingLength.get());
+    sendMessages();
+}
+
+void HpccConnectionPoolApp::socketPeerClosed(TcpSocket *socket)
+{
+    if (socket->getState() == TcpSocket::PEER_CLOSED)
+        socket->close();
+}
+
+void HpccConnectionPoolApp::socketFailure(TcpSocket *socket, int code)
+{
+    // the messages in flight on a failed connection are lost, the rest of the pool carries on
+    Connection& connection = getConnection(socket);
+    EV_WARN << "Pool connection " << socket->getSocketId() << " failed with code " << code << ", dropping " << connection.inFlight.size() << " messages.\n";
+    numOutstandingMessages -= connection.inFlight.size();
+    connection.inFlight.clear();
+    connection.outstandingLength = B(0);
+    sendMessages();
+}
+
+/**
+ * Records per connection bytes, Jain's index of the bytes over the pool connections (1 if the scheduler spread the
+ * load evenly) and the aggregate throughput from the first message sent to the last one acknowledged.
+ */
+void HpccConnectionPoolApp::finish()
+{
+    double sum = 0, sumOfSquares = 0;
+    long completed = 0;
+    for (size_t i = 0; i < connections.size(); i++) {
+        const Connection& connection = connections[i];
+        std::string prefix = "connection[" + std::to_string(i) + "]";
+        recordScalar((prefix + ":bytesSent").c_str(), connection.bytesSent);
+        recordScalar((prefix + ":messages").c_str(), connection.numMessages);
+        sum += connection.bytesCompleted;
+        sumOfSquares += (double)connection.bytesCompleted * connection.bytesCompleted;
+        completed += connection.numMessages;
+    }
+    recordScalar("poolSize", connections.size());
+    recordScalar("messagesCompleted", completed);
+    recordScalar("loadSpreadFairness", sumOfSquares > 0 ? sum * sum / (connections.size() * sumOfSquares) : 1);
+    if (firstSendTime >= SIMTIME_ZERO && lastCompletionTime > firstSendTime)
+        recordScalar("throughput", sum * 8 / (lastCompletionTime - firstSendTime).dbl(), "bps");
+    ApplicationBase::finish();
+}
+
+} // namespace inet
@@ -0,0 +1,110 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef APPLICATIONS_TCPAPP_HPCCCONNECTIONPOOLAPP_H_
+#define APPLICATIONS_TCPAPP_HPCCCONNECTIONPOOLAPP_H_
+
+#include <deque>
+#include <vector>
+#include <inet/applications/base/ApplicationBase.h>
+#include <inet/common/socket/SocketMap.h>
+#include <inet/transportlayer/contract/tcp/TcpSocket.h>
+
+namespace inet {
+
+/**
+ * Client that keeps a pool of poolSize connections to each of its servers and spreads application messages over
+ * them, round robin or to the connection with the fewest outstanding bytes. Every message is a GenericAppMsg that
+ * the TcpGenericServerApp at the other end acknowledges with a replyLength reply; a message is outstanding from
+ * sending it until its acknowledgement arrives.
+ */
+class HpccConnectionPoolApp : public ApplicationBase, public TcpSocket::ICallback
+{
+protected:
+    enum Scheduler { ROUND_ROBIN, LEAST_OUTSTANDING };
+
+    struct Message {
+        simtime_t sendTime;
+        B length;
+        B remainingReplyLength;
+    };
+
+    struct Connection {
+        TcpSocket *socket = nullptr;
+        std::deque<Message> inFlight;
+        B outstandingLength = B(0);
+        long bytesSent = 0;
+        long bytesCompleted = 0;
+        long numMessages = 0;
+    };
+
+    static simsignal_t messageLatencySignal;
+    static simsignal_t outstandingLengthSignal;
+
+    Scheduler scheduler;
+    int poolSize;
+    int connectPort;
+    B replyLength;
+    simtime_t startTime;
+    simtime_t stopTime;
+    long numMessages;
+    int maxOutstandingMessages;
+    bool backlogged;
+
+    cMessage *messageTimer = nullptr;
+    SocketMap socketMap;
+    std::vector<Connection> connections;
+    std::deque<B> queuedMessages; // generated but waiting for the outstanding message limit
+    int nextConnection = 0;
+    int numEstablished = 0;
+    int numOutstandingMessages = 0;
+    long numMessagesGenerated = 0;
+    simtime_t firstSendTime = -1;
+    simtime_t lastCompletionTime;
+
+protected:
+    virtual int numInitStages() const override { return NUM_INIT_STAGES; }
+    virtual void initialize(int stage) override;
+    virtual void handleMessageWhenUp(cMessage *msg) override;
+    virtual void finish() override;
+
+    virtual void connect();
+    virtual bool canGenerateMessage() const;
+    virtual void generateMessage();
+    virtual void sendMessages();
+    virtual Connection *selectConnection();
+    virtual void sendMessage(Connection& connection, B length);
+    virtual Connection& getConnection(TcpSocket *socket);
+
+    virtual void socketDataArrived(TcpSocket *socket, Packet *packet, bool urgent) override;
+    virtual void socketAvailable(TcpSocket *socket, TcpAvailableInfo *availableInfo) override { socket->accept(availableInfo->getNewSocketId()); }
+    virtual void socketEstablished(TcpSocket *socket) override;
+    virtual void socketPeerClosed(TcpSocket *socket) override;
+    virtual void socketClosed(TcpSocket *socket) override {}
+    virtual void socketFailure(TcpSocket *socket, int code) override;
+    virtual void socketStatusArrived(TcpSocket *socket, TcpStatusInfo *status) override {}
+    virtual void socketDeleted(TcpSocket *socket) override {}
+
+    virtual void handleStartOperation(LifecycleOperation *operation) override;
+    virtual void handleStopOperation(LifecycleOperation *operation) override;
+    virtual void handleCrashOperation(LifecycleOperation *operation) override;
+
+public:
+    virtual ~HpccConnectionPoolApp();
+};
+
+} // namespace inet
+
+#endif
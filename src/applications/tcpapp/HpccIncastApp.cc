@@ -0,0 +1,219 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include <inet/applications/tcpapp/GenericAppMsg_m.h>
+#include <inet/common/ModuleAccess.h>
+#include <inet/common/TimeTag_m.h>
+#include <inet/common/packet/Packet.h>
+#include <inet/networklayer/common/L3AddressResolver.h>
+
+#include "HpccIncastApp.h"
+
+namespace inet {
+
+Define_Module(HpccIncastApp);
+
+simsignal_t HpccIncastApp::queryCompletionTimeSignal = registerSignal("queryCompletionTime");
+simsignal_t HpccIncastApp::responseCompletionTimeSignal = registerSignal("responseCompletionTime");
+
+HpccIncastApp::~HpccIncastApp()
+{
+    cancelAndDelete(roundTimer);
+    socketMap.deleteSockets();
+}
+
+void HpccIncastApp::initialize(int stage)
+{
+    ApplicationBase::initialize(stage);
+    if (stage == INITSTAGE_LOCAL) {
+        connectPort = par("connectPort");
+        requestLength = B(par("requestLength").intValue());
+        responseLength = B(par("responseLength").intValue());
+        startTime = par("startTime");
+        stopTime = par("stopTime");
+        roundInterval = par("roundInterval");
+        numRounds = par("numRounds");
+        if (requestLength <= B(0) || responseLength <= B(0))
+            throw cRuntimeError("requestLength and responseLength must be positive");
+        if (stopTime >= SIMTIME_ZERO && stopTime < startTime)
+            throw cRuntimeError("Invalid startTime/stopTime parameters");
+        roundTimer = new cMessage("round");
+    }
+    else if (stage == INITSTAGE_APPLICATION_LAYER)
+        resolveConnectAddresses();
+}
+
+/**
+ * Besides addresses and module paths, connectAddresses accepts "name[*]" for every element of the module vector
+ * "name" in the network, so the fan-in degree follows the size of the responder vector.
+ */
+void HpccIncastApp::resolveConnectAddresses()
+{
+    cModule *network = getSimulation()->getSystemModule();
+    cStringTokenizer tokenizer(par("connectAddresses"));
+    while (tokenizer.hasMoreTokens()) {
+        std::string token = tokenizer.nextToken();
+        if (token.size() > 3 && token.compare(token.size() - 3, 3, "[*]") == 0) {
+            std::string name = token.substr(0, token.size() - 3);
+            int size = network->getSubmoduleVectorSize(name.c_str());
+            for (int i = 0; i < size; i++)
+                connectAddresses.push_back(L3AddressResolver().resolve((name + "[" + std::to_string(i) + "]").c_str()));
+        }
+        else
+            connectAddresses.push_back(L3AddressResolver().resolve(token.c_str()));
+    }
+    if (connectAddresses.empty())
+        throw cRuntimeError("connectAddresses is empty");
+}
+
+void HpccIncastApp::handleMessageWhenUp(cMessage *msg)
+{
+    if (msg == roundTimer) {
+        if (socketMap.size() == 0)
+            connect();
+        else
+            startRound();
+    }
+    else {
+        TcpSocket *socket = check_and_cast_nullable<TcpSocket *>(socketMap.findSocketFor(msg));
+        if (socket != nullptr)
+            socket->processMessage(msg);
+        else {
+            EV_WARN << "Message " << msg->getName() << " arrived for an unknown socket, dropping it.\n";
+            delete msg;
+        }
+    }
+}
+
+void HpccIncastApp::connect()
+{
+    for (const auto& connectAddress : connectAddresses) {
+        TcpSocket *socket = new TcpSocket();
+        socket->setOutputGate(gate("socketOut"));
+        socket->setCallback(this);
+        socket->bind(L3Address(), -1);
+        socket->connect(connectAddress, connectPort);
+        socketMap.addSocket(socket);
+    }
+    EV_INFO << "Connecting to " << connectAddresses.size() << " responders.\n";
+}
+
+void HpccIncastApp::socketEstablished(TcpSocket *socket)
+{
+    // the first round waits for every connection, so that it measures the incast rather than the handshakes
+    if (++numEstablished == (int)connectAddresses.size())
+        scheduleAt(simTime(), roundTimer);
+}
+
+void HpccIncastApp::startRound()
+{
+    roundStartTime = simTime();
+    numRoundsStarted++;
+    numPendingResponses = 0;
+    for (auto& entry : socketMap.getMap()) {
+        TcpSocket *socket = static_cast<TcpSocket *>(entry.second);
+        if (socket->getState() != TcpSocket::CONNECTED)
+            continue;
+        const auto& request = makeShared<GenericAppMsg>();
+        request->setChunkLength(requestLength);
+        request->setExpectedReplyLength(responseLength);
+        request->setServerClose(false);
+        request->addTag<CreationTimeTag>()->setCreationTime(simTime());
+        Packet *packet = new Packet("request");
+        packet->insertAtBack(request);
+        socket->send(packet);
+        bytesPending[socket->getSocketId()] = responseLength;
+        numPendingResponses++;
+    }
+    EV_INFO << "Round " << numRoundsStarted << ": requesting " << responseLength << " from " << numPendingResponses << " responders.\n";
+    if (numPendingResponses == 0)
+        throw cRuntimeError("No responder connection is open");
+}
+
+void HpccIncastApp::socketDataArrived(TcpSocket *socket, Packet *packet, bool urgent)
+{
+    auto it = bytesPending.find(socket->getSocketId());
+    if (it != bytesPending.end() && it->second > B(0)) {
+        it->second -= std::min(it->second, B(packet->getByteLength()));
+        if (it->second == B(0))
+            responseCompleted(socket);
+    }
+    delete packet;
+}
+
+void HpccIncastApp::responseCompleted(TcpSocket *socket)
+{
+    emit(responseCompletionTimeSignal, simTime() - roundStartTime);
+    if (--numPendingResponses > 0)
+        return;
+    simtime_t queryCompletionTime = simTime() - roundStartTime;
+    numRoundsCompleted++;
+    emit(queryCompletionTimeSignal, queryCompletionTime);
+    EV_INFO << "Round " << numRoundsCompleted << " completed in " << queryCompletionTime << ".\n";
+    scheduleNextRound();
+}
+
+void HpccIncastApp::scheduleNextRound()
+{
+    simtime_t next = std::max(simTime() + roundInterval, startTime);
+    if ((stopTime < SIMTIME_ZERO || next < stopTime) && (numRounds < 0 || numRoundsStarted < numRounds))
+        scheduleAt(next, roundTimer);
+}
+
+void HpccIncastApp::socketPeerClosed(TcpSocket *socket)
+{
+    if (socket->getState() == TcpSocket::PEER_CLOSED)
+        socket->close();
+}
+
+void HpccIncastApp::socketFailure(TcpSocket *socket, int code)
+{
+    // a lost responder would stall every later round, so this is fatal
+    throw cRuntimeError("Connection of socket %d failed with code %d", socket->getSocketId(), code);
+}
+
+void HpccIncastApp::handleStartOperation(LifecycleOperation *operation)
+{
+    if (stopTime < SIMTIME_ZERO || startTime < stopTime)
+        scheduleAt(std::max(simTime(), startTime), roundTimer);
+}
+
+void HpccIncastApp::handleStopOperation(LifecycleOperation *operation)
+{
+    cancelEvent(roundTimer);
+    for (auto& entry : socketMap.getMap())
+        static_cast<TcpSocket *>(entry.second)->close();
+    delayActiveOperationFinish(par("stopOperationTimeout"));
+}
+
+void HpccIncastApp::handleCrashOperation(LifecycleOperation *operation)
+{
+    cancelEvent(roundTimer);
+    for (auto& entry : socketMap.getMap())
+        static_cast<TcpSocket *>(entry.second)->destroy();
+    socketMap.deleteSockets();
+    bytesPending.clear();
+    numEstablished = 0;
+}
+
+void HpccIncastApp::finish()
+{
+    recordScalar("fanIn", connectAddresses.size());
+    recordScalar("roundsStarted", numRoundsStarted);
+    recordScalar("roundsCompleted", numRoundsCompleted);
+    ApplicationBase::finish();
+}
+
+} // namespace inet
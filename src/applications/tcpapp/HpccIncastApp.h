@@ -0,0 +1,88 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef APPLICATIONS_TCPAPP_HPCCINCASTAPP_H_
+#define APPLICATIONS_TCPAPP_HPCCINCASTAPP_H_
+
+#include <map>
+#include <vector>
+#include <inet/applications/base/ApplicationBase.h>
+#include <inet/common/socket/SocketMap.h>
+#include <inet/networklayer/common/L3Address.h>
+#include <inet/transportlayer/contract/tcp/TcpSocket.h>
+
+namespace inet {
+
+/**
+ * Requester of a partition/aggregate (incast) workload. It keeps one connection open to every responder and in each
+ * round asks all of them at once for a fixed size response. The round (query) completes when the last response has
+ * fully arrived; the next round starts after roundInterval. The responders are TcpGenericServerApps.
+ */
+class HpccIncastApp : public ApplicationBase, public TcpSocket::ICallback
+{
+protected:
+    static simsignal_t queryCompletionTimeSignal;
+    static simsignal_t responseCompletionTimeSignal;
+
+    std::vector<L3Address> connectAddresses;
+    int connectPort;
+    B requestLength;
+    B responseLength;
+    simtime_t startTime;
+    simtime_t stopTime;
+    simtime_t roundInterval;
+    long numRounds;
+
+    cMessage *roundTimer = nullptr;
+    SocketMap socketMap;
+    std::map<int, B> bytesPending; // of the current response, by socket id
+    int numEstablished = 0;
+    int numPendingResponses = 0;
+    simtime_t roundStartTime;
+    long numRoundsStarted = 0;
+    long numRoundsCompleted = 0;
+
+protected:
+    virtual int numInitStages() const override { return NUM_INIT_STAGES; }
+    virtual void initialize(int stage) override;
+    virtual void handleMessageWhenUp(cMessage *msg) override;
+    virtual void finish() override;
+
+    virtual void resolveConnectAddresses();
+    virtual void connect();
+    virtual void startRound();
+    virtual void responseCompleted(TcpSocket *socket);
+    virtual void scheduleNextRound();
+
+    virtual void socketDataArrived(TcpSocket *socket, Packet *packet, bool urgent) override;
+    virtual void socketAvailable(TcpSocket *socket, TcpAvailableInfo *availableInfo) override { socket->accept(availableInfo->getNewSocketId()); }
+    virtual void socketEstablished(TcpSocket *socket) override;
+    virtual void socketPeerClosed(TcpSocket *socket) override;
+    virtual void socketClosed(TcpSocket *socket) override {}
+    virtual void socketFailure(TcpSocket *socket, int code) override;
+    virtual void socketStatusArrived(TcpSocket *socket, TcpStatusInfo *status) override {}
+    virtual void socketDeleted(TcpSocket *socket) override {}
+
+    virtual void handleStartOperation(LifecycleOperation *operation) override;
+    virtual void handleStopOperation(LifecycleOperation *operation) override;
+    virtual void handleCrashOperation(LifecycleOperation *operation) override;
+
+public:
+    virtual ~HpccIncastApp();
+};
+
+} // namespace inet
+
+#endif
@@ -0,0 +1,168 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include <algorithm>
+#include <inet/applications/tcpapp/GenericAppMsg_m.h>
+#include <inet/common/ModuleAccess.h>
+#include <inet/common/TimeTag_m.h>
+#include <inet/common/packet/Packet.h>
+
+#include "../../common/LogHistogram.h"
+#include "HpccRpcClientApp.h"
+
+namespace inet {
+
+Define_Module(HpccRpcClientApp);
+
+simsignal_t HpccRpcClientApp::rpcLatencySignal = registerSignal("rpcLatency");
+
+HpccRpcClientApp::~HpccRpcClientApp()
+{
+    cancelAndDelete(timeoutMsg);
+}
+
+void HpccRpcClientApp::initialize(int stage)
+{
+    TcpAppBase::initialize(stage);
+    if (stage == INITSTAGE_LOCAL) {
+        concurrency = par("concurrency");
+        numCalls = par("numCalls");
+        startTime = par("startTime");
+        stopTime = par("stopTime");
+        if (concurrency < 1)
+            throw cRuntimeError("concurrency must be at least 1");
+        if (stopTime >= SIMTIME_ZERO && stopTime < startTime)
+            throw cRuntimeError("Invalid startTime/stopTime parameters");
+        timeoutMsg = new cMessage("timer");
+        initializeLogHistogram(latencyHistogram, "rpcLatencyHistogram", 1E-6, 10); // seconds
+    }
+}
+
+void HpccRpcClientApp::handleStartOperation(LifecycleOperation *operation)
+{
+    simtime_t start = std::max(startTime, simTime());
+    if (stopTime < SIMTIME_ZERO || start < stopTime)
+        scheduleAt(start, timeoutMsg);
+}
+
+void HpccRpcClientApp::handleStopOperation(LifecycleOperation *operation)
+{
+    cancelEvent(timeoutMsg);
+    if (socket.isOpen())
+        close();
+    delayActiveOperationFinish(par("stopOperationTimeout"));
+}
+
+void HpccRpcClientApp::handleCrashOperation(LifecycleOperation *operation)
+{
+    cancelEvent(timeoutMsg);
+    if (operation->getRootModule() != getContainingNode(this))
+        socket.destroy();
+    outstandingCalls.clear();
+}
+
+void HpccRpcClientApp::handleTimer(cMessage *msg)
+{
+    if (msg == timeoutMsg) {
+        if (socket.getState() == TcpSocket::NOT_BOUND || socket.getState() == TcpSocket::CLOSED)
+            connect();
+        else if (socket.getState() == TcpSocket::CONNECTED)
+            close(); // stopTime reached
+    }
+    else
+        throw cRuntimeError("Unknown timer: %s", msg->getName());
+}
+
+void HpccRpcClientApp::socketEstablished(TcpSocket *socket)
+{
+    TcpAppBase::socketEstablished(socket);
+    if (stopTime >= SIMTIME_ZERO)
+        scheduleAt(std::max(stopTime, simTime()), timeoutMsg);
+    sendCalls();
+}
+
+/**
+ * Tops the outstanding calls up to concurrency.
+ */
+void HpccRpcClientApp::sendCalls()
+{
+    while ((int)outstandingCalls.size() < concurrency && (numCalls < 0 || numCallsSent < numCalls)) {
+        B requestLength = B(par("requestLength").intValue());
+        B responseLength = B(par("responseLength").intValue());
+        if (requestLength < B(1) || responseLength < B(1))
+            throw cRuntimeError("requestLength and responseLength must be positive");
+        const auto& request = makeShared<GenericAppMsg>();
+        request->setChunkLength(requestLength);
+        request->setExpectedReplyLength(responseLength);
+        request->setServerClose(false);
+        request->addTag<CreationTimeTag>()->setCreationTime(simTime());
+        Packet *packet = new Packet("request");
+        packet->insertAtBack(request);
+        sendPacket(packet);
+        outstandingCalls.push_back(Call{simTime(), responseLength});
+        numCallsSent++;
+    }
+}
+
+void HpccRpcClientApp::socketDataArrived(TcpSocket *socket, Packet *packet, bool urgent)
+{
+    B length = B(packet->getByteLength());
+    TcpAppBase::socketDataArrived(socket, packet, urgent);
+    // a segment may end one reply and start the next one
+    while (length > B(0) && !outstandingCalls.empty()) {
+        Call& call = outstandingCalls.front();
+        B consumed = std::min(length, call.remainingLength);
+        call.remainingLength -= consumed;
+        length -= consumed;
+        if (call.remainingLength == B(0)) {
+            callCompleted(call);
+            outstandingCalls.pop_front();
+        }
+    }
+    if (stopTime < SIMTIME_ZERO || simTime() < stopTime)
+        sendCalls();
+}
+
+void HpccRpcClientApp::callCompleted(const Call& call)
+{
+    simtime_t latency = simTime() - call.sendTime;
+    numCallsCompleted++;
+    latencyHistogram.collect(latency);
+    emit(rpcLatencySignal, latency);
+}
+
+void HpccRpcClientApp::socketClosed(TcpSocket *socket)
+{
+    TcpAppBase::socketClosed(socket);
+    cancelEvent(timeoutMsg);
+    outstandingCalls.clear();
+}
+
+void HpccRpcClientApp::socketFailure(TcpSocket *socket, int code)
+{
+    TcpAppBase::socketFailure(socket, code);
+    cancelEvent(timeoutMsg);
+    outstandingCalls.clear();
+}
+
+void HpccRpcClientApp::finish()
+{
+    TcpAppBase::finish();
+    recordScalar("callsSent", numCallsSent);
+    recordScalar("callsCompleted", numCallsCompleted);
+    recordLogHistogram(this, latencyHistogram, "rpcLatency");
+}
+
+} // namespace inet
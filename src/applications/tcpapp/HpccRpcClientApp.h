@@ -0,0 +1,75 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef APPLICATIONS_TCPAPP_HPCCRPCCLIENTAPP_H_
+#define APPLICATIONS_TCPAPP_HPCCRPCCLIENTAPP_H_
+
+#include <deque>
+#include <inet/applications/tcpapp/TcpAppBase.h>
+
+namespace inet {
+
+/**
+ * Closed loop RPC client multiplexing its calls over one long-lived connection. Up to concurrency calls are
+ * outstanding at any time, each a GenericAppMsg request that asks the TcpGenericServerApp at the other end for a
+ * reply of responseLength bytes. The server answers in order, so replies are matched to calls first in first out.
+ */
+class HpccRpcClientApp : public TcpAppBase
+{
+protected:
+    struct Call {
+        simtime_t sendTime;
+        B remainingLength; // of the reply
+    };
+
+    static simsignal_t rpcLatencySignal;
+
+    int concurrency;
+    long numCalls;
+    simtime_t startTime;
+    simtime_t stopTime;
+
+    cMessage *timeoutMsg = nullptr;
+    std::deque<Call> outstandingCalls;
+    long numCallsSent = 0;
+    long numCallsCompleted = 0;
+
+    // Log-bucketed, so the tail percentiles cost no per call state
+    cHistogram latencyHistogram;
+
+protected:
+    virtual void initialize(int stage) override;
+    virtual void handleTimer(cMessage *msg) override;
+    virtual void finish() override;
+
+    virtual void sendCalls();
+    virtual void callCompleted(const Call& call);
+
+    virtual void socketEstablished(TcpSocket *socket) override;
+    virtual void socketDataArrived(TcpSocket *socket, Packet *packet, bool urgent) override;
+    virtual void socketClosed(TcpSocket *socket) override;
+    virtual void socketFailure(TcpSocket *socket, int code) override;
+
+    virtual void handleStartOperation(LifecycleOperation *operation) override;
+    virtual void handleStopOperation(LifecycleOperation *operation) override;
+    virtual void handleCrashOperation(LifecycleOperation *operation) override;
+
+public:
+    virtual ~HpccRpcClientApp();
+};
+
+} // namespace inet
+
+#endif
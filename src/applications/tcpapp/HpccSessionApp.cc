@@ -20,9 +20,10 @@
 #include <inet/common/lifecycle/ModuleOperations.h>
 #include <inet/common/packet/Packet.h>
 #include <inet/common/packet/chunk/ByteCountChunk.h>
-#include <inet/common/packet/chunk/BytesChunk.h>
 #include <inet/networklayer/common/L3AddressResolver.h>
 
+#include "../../common/DeadlineTag_m.h"
+#include "../../common/PatternChunk_m.h"
 #include "HpccSessionApp.h"
 
 namespace inet {
@@ -41,17 +42,18 @@ Packet *HpccSessionApp::createDataPacket(long sendBytes)
         payload = applicationPacket;
     }
     else if (!strcmp(dataTransferMode, "bytestream")) {
-        const auto& bytesChunk = makeShared<BytesChunk>();
-        std::vector<uint8_t> vec;
-        vec.resize(sendBytes);
-        for (int i = 0; i < sendBytes; i++)
-            vec[i] = (bytesSent + i) & 0xFF;
-        bytesChunk->setBytes(vec);
-        payload = bytesChunk;
+        // same content as a BytesChunk of (bytesSent + i) & 0xFF, generated only if it is serialized
+        const auto& patternChunk = makeShared<PatternChunk>();
+        patternChunk->setStreamOffset(bytesSent);
+        patternChunk->setChunkLength(B(sendBytes));
+        payload = patternChunk;
     }
     else
         throw cRuntimeError("Invalid data transfer mode: %s", dataTransferMode);
     payload->addTag<CreationTimeTag>()->setCreationTime(simTime());
+    simtime_t deadline = par("deadline");
+    if (deadline > SIMTIME_ZERO)
+        payload->addTag<DeadlineTag>()->setDeadline(simTime() + deadline);
     Packet *packet = new Packet("data1");
     packet->insertAtBack(payload);
     //packet->addTag<IntTag>();
@@ -0,0 +1,130 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include <algorithm>
+#include <cmath>
+#include <inet/common/ModuleAccess.h>
+#include <inet/networklayer/common/L3AddressResolver.h>
+#include <inet/networklayer/contract/IInterfaceTable.h>
+
+#include "HpccSinkApp.h"
+
+namespace inet {
+
+Define_Module(HpccSinkApp);
+
+simsignal_t HpccSinkApp::flowIdSignal = registerSignal("flowId");
+simsignal_t HpccSinkApp::flowSizeSignal = registerSignal("flowSize");
+simsignal_t HpccSinkApp::flowCompletionTimeSignal = registerSignal("flowCompletionTime");
+simsignal_t HpccSinkApp::flowSlowdownSignal = registerSignal("flowSlowdown");
+simsignal_t HpccSinkApp::deadlineMetSignal = registerSignal("deadlineMet");
+
+void HpccSinkApp::initialize(int stage)
+{
+    TcpSinkApp::initialize(stage);
+    if (stage == INITSTAGE_LOCAL) {
+        baseRtt = par("fctBaseRtt");
+        cStringTokenizer tokenizer(par("fctSizeClasses"));
+        while (tokenizer.hasMoreTokens()) {
+            long bound = std::stol(tokenizer.nextToken());
+            if (!sizeClassBounds.empty() && bound <= sizeClassBounds.back())
+                throw cRuntimeError("fctSizeClasses must be ascending");
+            sizeClassBounds.push_back(bound);
+        }
+        // the last class holds everything above the last bound
+        slowdownsBySizeClass.resize(sizeClassBounds.size() + 1);
+    }
+    else if (stage == INITSTAGE_APPLICATION_LAYER)
+        lineRate = getLinkDatarate();
+}
+
+/**
+ * The fctLineRate parameter, or if it is zero the datarate of the host's first non-loopback interface.
+ */
+double HpccSinkApp::getLinkDatarate()
+{
+    double datarate = par("fctLineRate");
+    if (datarate > 0)
+        return datarate;
+    IInterfaceTable *interfaceTable = L3AddressResolver().findInterfaceTableOf(getContainingNode(this));
+    for (int i = 0; interfaceTable != nullptr && i < interfaceTable->getNumInterfaces(); i++) {
+        NetworkInterface *networkInterface = interfaceTable->getInterface(i);
+        if (!networkInterface->isLoopback() && networkInterface->getDatarate() > 0)
+            return networkInterface->getDatarate();
+    }
+    throw cRuntimeError("Cannot determine the line rate, set fctLineRate");
+}
+
+double HpccSinkApp::getIdealFlowCompletionTime(long size) const
+{
+    return baseRtt.dbl() + size * 8 / lineRate;
+}
+
+size_t HpccSinkApp::getSizeClass(long size) const
+{
+    return std::lower_bound(sizeClassBounds.begin(), sizeClassBounds.end(), size) - sizeClassBounds.begin();
+}
+
+void HpccSinkApp::flowCompleted(const FlowRecord& flow)
+{
+    double fct = (flow.completionTime - flow.startTime).dbl();
+    double slowdown = std::max(1.0, fct / getIdealFlowCompletionTime(flow.size));
+    numFlows++;
+    slowdownsBySizeClass[getSizeClass(flow.size)].push_back(slowdown);
+    emit(flowIdSignal, (long)flow.flowId);
+    emit(flowSizeSignal, flow.size);
+    emit(flowCompletionTimeSignal, fct);
+    emit(flowSlowdownSignal, slowdown);
+    EV_INFO << "Flow " << flow.flowId << " of " << flow.size << "B completed in " << fct << "s, slowdown " << slowdown << ".\n";
+    if (flow.deadline >= SIMTIME_ZERO) {
+        bool met = flow.completionTime <= flow.deadline;
+        numFlowsWithDeadline++;
+        if (met)
+            numDeadlinesMet++;
+        emit(deadlineMetSignal, met);
+        EV_INFO << "Flow " << flow.flowId << (met ? " met" : " missed") << " its deadline " << flow.deadline << ".\n";
+    }
+}
+
+void HpccSinkApp::recordPercentiles(size_t sizeClass)
+{
+    std::vector<double>& slowdowns = slowdownsBySizeClass[sizeClass];
+    if (slowdowns.empty())
+        return;
+    std::string name = "slowdown";
+    name += sizeClass == 0 ? std::string("[0,") : "(" + std::to_string(sizeClassBounds[sizeClass - 1]) + ",";
+    name += sizeClass == sizeClassBounds.size() ? std::string("inf)") : std::to_string(sizeClassBounds[sizeClass]) + "]";
+    std::sort(slowdowns.begin(), slowdowns.end());
+    // nearest rank percentiles
+    auto percentile = [&](double p) { return slowdowns[std::max<size_t>(1, std::ceil(p * slowdowns.size())) - 1]; };
+    recordScalar((name + ":count").c_str(), slowdowns.size());
+    recordScalar((name + ":p50").c_str(), percentile(0.5));
+    recordScalar((name + ":p99").c_str(), percentile(0.99));
+}
+
+void HpccSinkApp::finish()
+{
+    TcpSinkApp::finish();
+    recordScalar("flowsCompleted", numFlows);
+    if (numFlowsWithDeadline > 0) {
+        recordScalar("flowsWithDeadline", numFlowsWithDeadline);
+        recordScalar("deadlinesMet", numDeadlinesMet);
+        recordScalar("deadlineMeetRate", (double)numDeadlinesMet / numFlowsWithDeadline);
+    }
+    for (size_t i = 0; i < slowdownsBySizeClass.size(); i++)
+        recordPercentiles(i);
+}
+
+} // namespace inet
@@ -0,0 +1,70 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef APPLICATIONS_TCPAPP_HPCCSINKAPP_H_
+#define APPLICATIONS_TCPAPP_HPCCSINKAPP_H_
+
+#include <vector>
+#include <inet/applications/tcpapp/TcpSinkApp.h>
+
+namespace inet {
+
+/**
+ * TcpSinkApp that collects one record per completed flow from its TcpThroughputSinkAppThread threads. The threads
+ * are deleted as soon as their connection closes, so the records and the per size class FCT slowdown percentiles
+ * computed in finish() live here.
+ */
+class HpccSinkApp : public TcpSinkApp
+{
+public:
+    struct FlowRecord {
+        int flowId;
+        long size; // bytes
+        simtime_t startTime;
+        simtime_t completionTime;
+        simtime_t deadline = -1; // -1 if the flow has none
+    };
+
+protected:
+    static simsignal_t flowIdSignal;
+    static simsignal_t flowSizeSignal;
+    static simsignal_t flowCompletionTimeSignal;
+    static simsignal_t flowSlowdownSignal;
+    static simsignal_t deadlineMetSignal;
+
+    double lineRate = 0; // bps
+    simtime_t baseRtt;
+    std::vector<long> sizeClassBounds; // upper bounds in bytes, ascending
+    std::vector<std::vector<double>> slowdownsBySizeClass;
+    long numFlows = 0;
+    long numFlowsWithDeadline = 0;
+    long numDeadlinesMet = 0;
+
+protected:
+    virtual void initialize(int stage) override;
+    virtual void finish() override;
+
+    virtual double getLinkDatarate();
+    virtual size_t getSizeClass(long size) const;
+    virtual void recordPercentiles(size_t sizeClass);
+
+public:
+    virtual double getIdealFlowCompletionTime(long size) const;
+    virtual void flowCompleted(const FlowRecord& flow);
+};
+
+} // namespace inet
+
+#endif
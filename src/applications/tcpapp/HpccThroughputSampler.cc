@@ -0,0 +1,125 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "HpccThroughputSampler.h"
+#include "TcpThroughputSinkAppThread.h"
+
+namespace inet {
+
+Define_Module(HpccThroughputSampler);
+
+simsignal_t HpccThroughputSampler::aggregateThroughputSignal = registerSignal("aggregateThroughput");
+simsignal_t HpccThroughputSampler::fairnessIndexSignal = registerSignal("fairnessIndex");
+simsignal_t HpccThroughputSampler::numFlowsSignal = registerSignal("numFlows");
+
+HpccThroughputSampler::~HpccThroughputSampler()
+{
+    cancelAndDelete(samplingTimer);
+}
+
+void HpccThroughputSampler::initialize()
+{
+    samplingInterval = par("samplingInterval");
+    summaryOnly = par("summaryOnly");
+    if (samplingInterval <= SIMTIME_ZERO)
+        throw cRuntimeError("samplingInterval must be positive");
+    samplingTimer = new cMessage("sample");
+    aggregateThroughputStatistic.setName("aggregateThroughput");
+    fairnessIndexStatistic.setName("fairnessIndex");
+    flowThroughputHistogram.setName("flowThroughput");
+    WATCH(numSamples);
+}
+
+void HpccThroughputSampler::registerThread(cModule *thread, long bytesReceived)
+{
+    Enter_Method("registerThread");
+    flows[thread->getId()] = FlowSample{bytesReceived, simTime()};
+    // the timer only runs while there is something to sample
+    if (!samplingTimer->isScheduled())
+        scheduleAfter(samplingInterval, samplingTimer);
+}
+
+void HpccThroughputSampler::unregisterThread(cModule *thread)
+{
+    Enter_Method("unregisterThread");
+    flows.erase(thread->getId());
+}
+
+void HpccThroughputSampler::handleMessage(cMessage *msg)
+{
+    if (msg != samplingTimer)
+        throw cRuntimeError("Unknown message: %s", msg->getName());
+    sample();
+    if (!flows.empty())
+        scheduleAfter(samplingInterval, samplingTimer);
+}
+
+/**
+ * Jain's index (sum x)^2 / (n * sum x^2) is 1 if all flows got the same throughput and 1/n if one flow got all of it.
+ */
+void HpccThroughputSampler::sample()
+{
+    double sum = 0;
+    double sumOfSquares = 0;
+    int n = 0;
+    for (auto it = flows.begin(); it != flows.end();) {
+        auto thread = dynamic_cast<TcpThroughputSinkAppThread *>(getSimulation()->getModule(it->first));
+        if (thread == nullptr) {
+            it = flows.erase(it);
+            continue;
+        }
+        FlowSample& flow = it->second;
+        simtime_t elapsed = simTime() - flow.lastSampleTime;
+        if (elapsed > SIMTIME_ZERO) {
+            long bytesReceived = thread->getBytesReceived();
+            double throughput = (bytesReceived - flow.lastBytesReceived) * 8 / elapsed.dbl();
+            flow.lastBytesReceived = bytesReceived;
+            flow.lastSampleTime = simTime();
+            if (summaryOnly)
+                flowThroughputHistogram.collect(throughput);
+            else
+                thread->emitThroughput(throughput);
+            sum += throughput;
+            sumOfSquares += throughput * throughput;
+            n++;
+        }
+        ++it;
+    }
+    if (n == 0)
+        return;
+    double fairnessIndex = sumOfSquares > 0 ? sum * sum / (n * sumOfSquares) : 1;
+    numSamples++;
+    if (summaryOnly) {
+        aggregateThroughputStatistic.collect(sum);
+        fairnessIndexStatistic.collect(fairnessIndex);
+    }
+    else {
+        emit(numFlowsSignal, (long)n);
+        emit(aggregateThroughputSignal, sum);
+        emit(fairnessIndexSignal, fairnessIndex);
+    }
+}
+
+void HpccThroughputSampler::finish()
+{
+    recordScalar("samples", numSamples);
+    if (summaryOnly) {
+        aggregateThroughputStatistic.record();
+        fairnessIndexStatistic.record();
+        flowThroughputHistogram.record();
+    }
+}
+
+} // namespace inet
@@ -0,0 +1,68 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef APPLICATIONS_TCPAPP_HPCCTHROUGHPUTSAMPLER_H_
+#define APPLICATIONS_TCPAPP_HPCCTHROUGHPUTSAMPLER_H_
+
+#include <map>
+#include <inet/common/INETDefs.h>
+
+namespace inet {
+
+/**
+ * Samples the receiver side throughput of every registered TcpThroughputSinkAppThread on one timer, instead of one
+ * timer per thread, and computes the aggregate throughput and Jain's fairness index of each sample.
+ */
+class HpccThroughputSampler : public cSimpleModule
+{
+protected:
+    struct FlowSample {
+        long lastBytesReceived;
+        simtime_t lastSampleTime;
+    };
+
+    static simsignal_t aggregateThroughputSignal;
+    static simsignal_t fairnessIndexSignal;
+    static simsignal_t numFlowsSignal;
+
+    simtime_t samplingInterval;
+    bool summaryOnly;
+
+    cMessage *samplingTimer = nullptr;
+    std::map<int, FlowSample> flows; // by thread module id, so threads deleted without unregistering are noticed
+    long numSamples = 0;
+
+    // Used instead of the signals in summaryOnly mode
+    cStdDev aggregateThroughputStatistic;
+    cStdDev fairnessIndexStatistic;
+    cHistogram flowThroughputHistogram;
+
+protected:
+    virtual void initialize() override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+
+    virtual void sample();
+
+public:
+    virtual ~HpccThroughputSampler();
+
+    virtual void registerThread(cModule *thread, long bytesReceived);
+    virtual void unregisterThread(cModule *thread);
+};
+
+} // namespace inet
+
+#endif
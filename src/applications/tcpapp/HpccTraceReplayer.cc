@@ -0,0 +1,274 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <inet/networklayer/common/L3AddressResolver.h>
+
+#include "HpccTraceReplayer.h"
+#include "HpccWorkloadApp.h"
+
+namespace inet {
+
+Define_Module(HpccTraceReplayer);
+
+// Binary trace: "HPFT", uint32 version, uint32 number of hosts, per host uint32 name length and the name,
+// then records of double start time, uint32 source and destination host index and uint64 size in bytes
+static const uint32_t TRACE_VERSION = 1;
+static const size_t BINARY_RECORD_SIZE = sizeof(double) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+HpccTraceReplayer::~HpccTraceReplayer()
+{
+    cancelAndDelete(flowTimer);
+    closeTrace();
+}
+
+void HpccTraceReplayer::initialize(int stage)
+{
+    if (stage == INITSTAGE_LOCAL) {
+        traceFile = par("traceFile").stdstringValue();
+        appModule = par("appModule").stdstringValue();
+        timeOffset = par("timeOffset");
+        maxFlows = par("maxFlows");
+        flowTimer = new cMessage("flowStart");
+        WATCH(numFlowsStarted);
+    }
+    else if (stage == INITSTAGE_APPLICATION_LAYER) {
+        // the hosts' addresses are assigned by now
+        openTrace();
+        scheduleNextFlow();
+    }
+}
+
+void HpccTraceReplayer::openTrace()
+{
+#ifdef _WIN32
+    std::ifstream stream(traceFile, std::ios::binary);
+    if (!stream)
+        throw cRuntimeError("Cannot open flow trace '%s'", traceFile.c_str());
+    traceBuffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    trace = traceBuffer.data();
+    traceSize = traceBuffer.size();
+#else
+    int fd = open(traceFile.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw cRuntimeError("Cannot open flow trace '%s'", traceFile.c_str());
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) < 0) {
+        close(fd);
+        throw cRuntimeError("Cannot open flow trace '%s'", traceFile.c_str());
+    }
+    traceSize = fileStat.st_size;
+    if (traceSize == 0) {
+        // an empty trace has no flows, and nothing to map
+        close(fd);
+        return;
+    }
+    void *data = mmap(nullptr, traceSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        throw cRuntimeError("Cannot map flow trace '%s'", traceFile.c_str());
+    // the trace is read front to back exactly once
+    madvise(data, traceSize, MADV_SEQUENTIAL);
+    trace = (const char *)data;
+#endif
+    binaryTrace = traceSize >= 4 && !memcmp(trace, "HPFT", 4);
+    if (binaryTrace)
+        readBinaryHeader();
+}
+
+void HpccTraceReplayer::closeTrace()
+{
+#ifndef _WIN32
+    if (trace != nullptr)
+        munmap((void *)trace, traceSize);
+#endif
+    trace = nullptr;
+    traceBuffer.clear();
+}
+
+void HpccTraceReplayer::readBinaryHeader()
+{
+    auto read = [&] (void *value, size_t size) {
+        if (traceOffset + size > traceSize)
+            throw cRuntimeError("Flow trace '%s' is truncated", traceFile.c_str());
+        memcpy(value, trace + traceOffset, size);
+        traceOffset += size;
+    };
+    char magic[4];
+    uint32_t version, numHosts;
+    read(magic, sizeof(magic));
+    read(&version, sizeof(version));
+    if (version != TRACE_VERSION)
+        throw cRuntimeError("Flow trace '%s' has unsupported version %u", traceFile.c_str(), version);
+    read(&numHosts, sizeof(numHosts));
+    for (uint32_t i = 0; i < numHosts; i++) {
+        uint32_t nameLength;
+        read(&nameLength, sizeof(nameLength));
+        if (traceOffset + nameLength > traceSize)
+            throw cRuntimeError("Flow trace '%s' is truncated", traceFile.c_str());
+        hostNames.push_back(std::string(trace + traceOffset, nameLength));
+        traceOffset += nameLength;
+    }
+    hostApps.resize(numHosts, nullptr);
+    hostAddresses.resize(numHosts);
+}
+
+/**
+ * Reads the record after the current one into nextRecord. Returns false at the end of the trace.
+ */
+bool HpccTraceReplayer::readNextRecord()
+{
+    if (maxFlows >= 0 && numFlowsStarted >= maxFlows)
+        return false;
+    if (!(binaryTrace ? readBinaryRecord() : readTextRecord()))
+        return false;
+    if (nextRecord.startTime < lastStartTime)
+        throw cRuntimeError("Flow trace '%s' is not sorted by start time at flow %ld", traceFile.c_str(), numFlowsStarted + 1);
+    lastStartTime = nextRecord.startTime;
+    return true;
+}
+
+bool HpccTraceReplayer::readBinaryRecord()
+{
+    if (traceOffset == traceSize)
+        return false;
+    if (traceOffset + BINARY_RECORD_SIZE > traceSize)
+        throw cRuntimeError("Flow trace '%s' is truncated", traceFile.c_str());
+    double startTime;
+    uint32_t source, destination;
+    uint64_t size;
+    const char *record = trace + traceOffset;
+    memcpy(&startTime, record, sizeof(startTime));
+    memcpy(&source, record + 8, sizeof(source));
+    memcpy(&destination, record + 12, sizeof(destination));
+    memcpy(&size, record + 16, sizeof(size));
+    traceOffset += BINARY_RECORD_SIZE;
+    if (source >= hostNames.size() || destination >= hostNames.size())
+        throw cRuntimeError("Flow trace '%s' refers to an unknown host index", traceFile.c_str());
+    if (hostApps[source] == nullptr)
+        hostApps[source] = findApp(hostNames[source]);
+    if (hostAddresses[destination].isUnspecified())
+        hostAddresses[destination] = findAddress(hostNames[destination]);
+    nextRecord.startTime = startTime;
+    nextRecord.sourceApp = hostApps[source];
+    nextRecord.destination = hostAddresses[destination];
+    nextRecord.size = size;
+    return true;
+}
+
+/**
+ * Text traces have one "startTime,source,destination,size" line per flow, times in seconds, hosts as module
+ * paths relative to the network and sizes in bytes. Empty lines, lines starting with # and a header line are skipped.
+ */
+bool HpccTraceReplayer::readTextRecord()
+{
+    while (traceOffset < traceSize) {
+        const char *begin = trace + traceOffset;
+        const char *newline = (const char *)memchr(begin, '\n', traceSize - traceOffset);
+        const char *end = newline != nullptr ? newline : trace + traceSize;
+        traceOffset = end - trace + (newline != nullptr ? 1 : 0);
+        numLines++;
+        std::string line(begin, end);
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::vector<std::string> fields = cStringTokenizer(line.c_str(), ",").asVector();
+        if (fields.size() != 4)
+            throw cRuntimeError("Flow trace '%s' line %ld: expected startTime,source,destination,size", traceFile.c_str(), numLines);
+        char *startTimeEnd;
+        double startTime = strtod(fields[0].c_str(), &startTimeEnd);
+        if (*startTimeEnd != '\0') {
+            if (numLines == 1)
+                continue; // header
+            throw cRuntimeError("Flow trace '%s' line %ld: invalid start time '%s'", traceFile.c_str(), numLines, fields[0].c_str());
+        }
+        auto appIt = appsByName.find(fields[1]);
+        if (appIt == appsByName.end())
+            appIt = appsByName.insert({fields[1], findApp(fields[1])}).first;
+        auto addressIt = addressesByName.find(fields[2]);
+        if (addressIt == addressesByName.end())
+            addressIt = addressesByName.insert({fields[2], findAddress(fields[2])}).first;
+        nextRecord.startTime = startTime;
+        nextRecord.sourceApp = appIt->second;
+        nextRecord.destination = addressIt->second;
+        nextRecord.size = std::atol(fields[3].c_str());
+        return true;
+    }
+    return false;
+}
+
+HpccWorkloadApp *HpccTraceReplayer::findApp(const std::string& hostName)
+{
+    cModule *host = getSimulation()->getSystemModule()->getModuleByPath(hostName.c_str());
+    if (host == nullptr)
+        throw cRuntimeError("Flow trace '%s' refers to unknown host '%s'", traceFile.c_str(), hostName.c_str());
+    cModule *app = host->getModuleByPath(appModule.c_str());
+    if (app == nullptr)
+        throw cRuntimeError("Host '%s' has no module '%s'", hostName.c_str(), appModule.c_str());
+    return check_and_cast<HpccWorkloadApp *>(app);
+}
+
+L3Address HpccTraceReplayer::findAddress(const std::string& hostName)
+{
+    return L3AddressResolver().resolve(hostName.c_str());
+}
+
+void HpccTraceReplayer::scheduleNextFlow()
+{
+    if (readNextRecord())
+        scheduleAt(std::max(simTime(), timeOffset + nextRecord.startTime), flowTimer);
+    else {
+        EV_INFO << "Flow trace " << traceFile << " finished after " << numFlowsStarted << " flows.\n";
+        closeTrace();
+    }
+}
+
+void HpccTraceReplayer::handleMessage(cMessage *msg)
+{
+    if (msg != flowTimer)
+        throw cRuntimeError("Unknown message: %s", msg->getName());
+    // flows with the same start time are started in one event
+    bool more;
+    do {
+        if (nextRecord.size > 0)
+            nextRecord.sourceApp->startFlow(nextRecord.destination, nextRecord.size);
+        numFlowsStarted++;
+        more = readNextRecord();
+    } while (more && timeOffset + nextRecord.startTime <= simTime());
+    if (more)
+        scheduleAt(timeOffset + nextRecord.startTime, flowTimer);
+    else {
+        EV_INFO << "Flow trace " << traceFile << " finished after " << numFlowsStarted << " flows.\n";
+        closeTrace();
+    }
+}
+
+void HpccTraceReplayer::finish()
+{
+    recordScalar("flowsStarted", numFlowsStarted);
+}
+
+} // namespace inet
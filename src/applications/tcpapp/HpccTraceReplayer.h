@@ -0,0 +1,92 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef APPLICATIONS_TCPAPP_HPCCTRACEREPLAYER_H_
+#define APPLICATIONS_TCPAPP_HPCCTRACEREPLAYER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <inet/common/INETDefs.h>
+#include <inet/networklayer/common/L3Address.h>
+
+namespace inet {
+
+class HpccWorkloadApp;
+
+/**
+ * Replays a flow trace (start time, source, destination, size) by starting every flow on the HpccWorkloadApp of its
+ * source host. The trace is memory-mapped and read one record ahead of the simulation, so only the record being
+ * waited for and the per host lookups are held in memory, however long the trace is.
+ */
+class HpccTraceReplayer : public cSimpleModule
+{
+protected:
+    struct TraceRecord {
+        simtime_t startTime;
+        HpccWorkloadApp *sourceApp = nullptr;
+        L3Address destination;
+        long size = 0;
+    };
+
+    std::string traceFile;
+    std::string appModule;
+    simtime_t timeOffset;
+    long maxFlows;
+
+    // Mapped trace and the read position of the next record
+    const char *trace = nullptr;
+    size_t traceSize = 0;
+    size_t traceOffset = 0;
+    std::vector<char> traceBuffer;
+    bool binaryTrace = false;
+    long numLines = 0;
+
+    // Host table of binary traces, resolved when a host is first used
+    std::vector<std::string> hostNames;
+    std::vector<HpccWorkloadApp *> hostApps;
+    std::vector<L3Address> hostAddresses;
+    // Hosts named in text traces
+    std::map<std::string, HpccWorkloadApp *> appsByName;
+    std::map<std::string, L3Address> addressesByName;
+
+    cMessage *flowTimer = nullptr;
+    TraceRecord nextRecord;
+    simtime_t lastStartTime;
+    long numFlowsStarted = 0;
+
+protected:
+    virtual int numInitStages() const override { return NUM_INIT_STAGES; }
+    virtual void initialize(int stage) override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+
+    virtual void openTrace();
+    virtual void closeTrace();
+    virtual void readBinaryHeader();
+    virtual bool readNextRecord();
+    virtual bool readBinaryRecord();
+    virtual bool readTextRecord();
+    virtual HpccWorkloadApp *findApp(const std::string& hostName);
+    virtual L3Address findAddress(const std::string& hostName);
+    virtual void scheduleNextFlow();
+
+public:
+    virtual ~HpccTraceReplayer();
+};
+
+} // namespace inet
+
+#endif
@@ -0,0 +1,277 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <inet/applications/base/ApplicationPacket_m.h>
+#include <inet/common/ModuleAccess.h>
+#include <inet/common/TimeTag_m.h>
+#include <inet/common/packet/Packet.h>
+#include <inet/common/packet/chunk/ByteCountChunk.h>
+#include <inet/networklayer/common/L3AddressResolver.h>
+#include <inet/networklayer/contract/IInterfaceTable.h>
+
+#include "HpccWorkloadApp.h"
+
+namespace inet {
+
+Define_Module(HpccWorkloadApp);
+
+simsignal_t HpccWorkloadApp::flowStartedSignal = registerSignal("flowStarted");
+simsignal_t HpccWorkloadApp::flowClosedSignal = registerSignal("flowClosed");
+
+HpccWorkloadApp::~HpccWorkloadApp()
+{
+    cancelAndDelete(arrivalTimer);
+    socketMap.deleteSockets();
+}
+
+void HpccWorkloadApp::initialize(int stage)
+{
+    ApplicationBase::initialize(stage);
+    if (stage == INITSTAGE_LOCAL) {
+        load = par("load");
+        if (load < 0)
+            throw cRuntimeError("load must not be negative");
+        if (load > 0)
+            readCdfFile(par("flowSizeCdfFile"));
+        connectPort = par("connectPort");
+        startTime = par("startTime");
+        stopTime = par("stopTime");
+        maxFlows = par("maxFlows");
+        if (stopTime >= SIMTIME_ZERO && stopTime < startTime)
+            throw cRuntimeError("Invalid startTime/stopTime parameters");
+        arrivalTimer = new cMessage("flowArrival");
+    }
+    else if (stage == INITSTAGE_APPLICATION_LAYER) {
+        // the addresses are resolved here, after the network configurator assigned them
+        cStringTokenizer tokenizer(par("connectAddresses"));
+        while (tokenizer.hasMoreTokens())
+            connectAddresses.push_back(L3AddressResolver().resolve(tokenizer.nextToken()));
+        if (load > 0) {
+            if (connectAddresses.empty())
+                throw cRuntimeError("connectAddresses is empty");
+            arrivalRate = load * getLinkDatarate() / (meanFlowSize * 8);
+            EV_INFO << "Mean flow size " << meanFlowSize << "B, " << arrivalRate << " flows/s for load " << load << ".\n";
+        }
+    }
+}
+
+/**
+ * Reads "size cdf" pairs, one per line; empty lines and lines starting with # are skipped. Sizes are in bytes and
+ * must not decrease, the cdf values must not decrease either and are normalized by the last one, so both fractions
+ * and percentages work. Sizes between two points are interpolated linearly.
+ */
+void HpccWorkloadApp::readCdfFile(const char *fileName)
+{
+    std::ifstream stream(fileName);
+    if (!stream)
+        throw cRuntimeError("Cannot open flow size CDF file '%s'", fileName);
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::istringstream lineStream(line);
+        double size, value;
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (!(lineStream >> size >> value))
+            throw cRuntimeError("Invalid line in flow size CDF file '%s': %s", fileName, line.c_str());
+        if (!cdfSizes.empty() && (size < cdfSizes.back() || value < cdfValues.back()))
+            throw cRuntimeError("Flow size CDF file '%s' is not monotonic at: %s", fileName, line.c_str());
+        cdfSizes.push_back(size);
+        cdfValues.push_back(value);
+    }
+    if (cdfValues.size() < 2 || cdfValues.back() <= 0)
+        throw cRuntimeError("Flow size CDF file '%s' needs at least two points", fileName);
+    double total = cdfValues.back();
+    for (auto& value : cdfValues)
+        value /= total;
+    // mean of the piecewise uniform distribution, the first point carries the probability mass of its cdf value
+    meanFlowSize = cdfSizes[0] * cdfValues[0];
+    for (size_t i = 1; i < cdfSizes.size(); i++)
+        meanFlowSize += (cdfValues[i] - cdfValues[i - 1]) * (cdfSizes[i] + cdfSizes[i - 1]) / 2;
+    if (meanFlowSize <= 0)
+        throw cRuntimeError("Flow size CDF file '%s' has a mean flow size of zero", fileName);
+}
+
+long HpccWorkloadApp::drawFlowSize()
+{
+    double value = uniform(0, 1);
+    auto it = std::lower_bound(cdfValues.begin(), cdfValues.end(), value);
+    size_t i = it - cdfValues.begin();
+    double size;
+    if (i == 0)
+        size = cdfSizes[0];
+    else {
+        double fraction = (value - cdfValues[i - 1]) / (cdfValues[i] - cdfValues[i - 1]);
+        size = cdfSizes[i - 1] + fraction * (cdfSizes[i] - cdfSizes[i - 1]);
+    }
+    return std::max(1L, (long)std::round(size));
+}
+
+/**
+ * The linkDatarate parameter, or if it is zero the datarate of the host's first non-loopback interface.
+ */
+double HpccWorkloadApp::getLinkDatarate()
+{
+    double datarate = par("linkDatarate");
+    if (datarate > 0)
+        return datarate;
+    IInterfaceTable *interfaceTable = L3AddressResolver().findInterfaceTableOf(getContainingNode(this));
+    for (int i = 0; interfaceTable != nullptr && i < interfaceTable->getNumInterfaces(); i++) {
+        NetworkInterface *networkInterface = interfaceTable->getInterface(i);
+        if (!networkInterface->isLoopback() && networkInterface->getDatarate() > 0)
+            return networkInterface->getDatarate();
+    }
+    throw cRuntimeError("Cannot determine the link datarate, set linkDatarate");
+}
+
+void HpccWorkloadApp::scheduleNextArrival()
+{
+    if (load == 0)
+        return;
+    simtime_t next = std::max(simTime(), startTime) + exponential(1 / arrivalRate);
+    if ((stopTime < SIMTIME_ZERO || next < stopTime) && (maxFlows < 0 || numFlowsStarted < maxFlows))
+        scheduleAt(next, arrivalTimer);
+}
+
+void HpccWorkloadApp::handleMessageWhenUp(cMessage *msg)
+{
+    if (msg == arrivalTimer) {
+        startFlow();
+        scheduleNextArrival();
+    }
+    else {
+        TcpSocket *socket = check_and_cast_nullable<TcpSocket *>(socketMap.findSocketFor(msg));
+        if (socket != nullptr)
+            socket->processMessage(msg);
+        else {
+            EV_WARN << "Message " << msg->getName() << " arrived for an unknown socket, dropping it.\n";
+            delete msg;
+        }
+    }
+}
+
+void HpccWorkloadApp::startFlow()
+{
+    startFlow(connectAddresses[intuniform(0, connectAddresses.size() - 1)], drawFlowSize());
+}
+
+void HpccWorkloadApp::startFlow(const L3Address& connectAddress, long flowSize)
+{
+    Enter_Method("startFlow");
+    TcpSocket *socket = new TcpSocket();
+    socket->setOutputGate(gate("socketOut"));
+    socket->setCallback(this);
+    socket->bind(L3Address(), -1);
+    socket->connect(connectAddress, connectPort);
+    socketMap.addSocket(socket);
+    pendingFlows[socket->getSocketId()] = Flow{flowSize, simTime()};
+    numFlowsStarted++;
+    emit(flowStartedSignal, flowSize);
+    EV_INFO << "Starting flow " << numFlowsStarted << " of " << flowSize << "B to " << connectAddress << ".\n";
+}
+
+/**
+ * The payload carries the time the flow was started rather than the time it was sent, so that the flow completion
+ * time measured by HpccSinkApp includes the connection setup.
+ */
+Packet *HpccWorkloadApp::createDataPacket(const Flow& flow)
+{
+    const char *dataTransferMode = par("dataTransferMode");
+    Ptr<Chunk> payload;
+    if (!strcmp(dataTransferMode, "bytecount"))
+        payload = makeShared<ByteCountChunk>(B(flow.size));
+    else if (!strcmp(dataTransferMode, "object")) {
+        const auto& applicationPacket = makeShared<ApplicationPacket>();
+        applicationPacket->setChunkLength(B(flow.size));
+        payload = applicationPacket;
+    }
+    else
+        throw cRuntimeError("Invalid data transfer mode: %s", dataTransferMode);
+    payload->addTag<CreationTimeTag>()->setCreationTime(flow.startTime);
+    Packet *packet = new Packet("data");
+    packet->insertAtBack(payload);
+    return packet;
+}
+
+void HpccWorkloadApp::socketEstablished(TcpSocket *socket)
+{
+    auto it = pendingFlows.find(socket->getSocketId());
+    if (it == pendingFlows.end())
+        return;
+    socket->send(createDataPacket(it->second));
+    socket->close();
+    pendingFlows.erase(it);
+}
+
+void HpccWorkloadApp::socketPeerClosed(TcpSocket *socket)
+{
+    if (socket->getState() == TcpSocket::PEER_CLOSED)
+        socket->close();
+}
+
+void HpccWorkloadApp::socketClosed(TcpSocket *socket)
+{
+    numFlowsClosed++;
+    emit(flowClosedSignal, 1L);
+    removeSocket(socket);
+}
+
+void HpccWorkloadApp::socketFailure(TcpSocket *socket, int code)
+{
+    EV_WARN << "Connection of socket " << socket->getSocketId() << " failed with code " << code << ".\n";
+    removeSocket(socket);
+}
+
+void HpccWorkloadApp::removeSocket(TcpSocket *socket)
+{
+    pendingFlows.erase(socket->getSocketId());
+    socketMap.removeSocket(socket);
+    delete socket;
+}
+
+void HpccWorkloadApp::handleStartOperation(LifecycleOperation *operation)
+{
+    scheduleNextArrival();
+}
+
+void HpccWorkloadApp::handleStopOperation(LifecycleOperation *operation)
+{
+    cancelEvent(arrivalTimer);
+    for (auto& entry : socketMap.getMap())
+        static_cast<TcpSocket *>(entry.second)->close();
+    delayActiveOperationFinish(par("stopOperationTimeout"));
+}
+
+void HpccWorkloadApp::handleCrashOperation(LifecycleOperation *operation)
+{
+    cancelEvent(arrivalTimer);
+    for (auto& entry : socketMap.getMap())
+        static_cast<TcpSocket *>(entry.second)->destroy();
+    socketMap.deleteSockets();
+    pendingFlows.clear();
+}
+
+void HpccWorkloadApp::finish()
+{
+    recordScalar("flowsStarted", numFlowsStarted);
+    recordScalar("flowsClosed", numFlowsClosed);
+    recordScalar("meanFlowSize", meanFlowSize);
+    ApplicationBase::finish();
+}
+
+} // namespace inet
@@ -0,0 +1,101 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef APPLICATIONS_TCPAPP_HPCCWORKLOADAPP_H_
+#define APPLICATIONS_TCPAPP_HPCCWORKLOADAPP_H_
+
+#include <map>
+#include <vector>
+#include <inet/applications/base/ApplicationBase.h>
+#include <inet/common/socket/SocketMap.h>
+#include <inet/networklayer/common/L3Address.h>
+#include <inet/transportlayer/contract/tcp/TcpSocket.h>
+
+namespace inet {
+
+/**
+ * Opens a new connection for every flow of a synthetic workload. Flow sizes are drawn from an empirical CDF file and
+ * flows arrive as a Poisson process whose rate makes the offered load a given fraction of the host's link capacity.
+ * Every flow sends its bytes to a uniformly chosen address of connectAddresses and closes the connection.
+ * With zero load the app starts no flows on its own and only serves startFlow() calls.
+ */
+class HpccWorkloadApp : public ApplicationBase, public TcpSocket::ICallback
+{
+protected:
+    static simsignal_t flowStartedSignal;
+    static simsignal_t flowClosedSignal;
+
+    // Piecewise linear CDF of flow sizes in bytes
+    std::vector<double> cdfSizes;
+    std::vector<double> cdfValues;
+    double meanFlowSize = 0;
+
+    double load;
+    std::vector<L3Address> connectAddresses;
+    int connectPort;
+    simtime_t startTime;
+    simtime_t stopTime;
+    long maxFlows;
+    double arrivalRate = 0; // flows per second
+
+    cMessage *arrivalTimer = nullptr;
+    SocketMap socketMap;
+    struct Flow {
+        long size;
+        simtime_t startTime;
+    };
+    std::map<int, Flow> pendingFlows; // by socket id, until the connection is established
+    long numFlowsStarted = 0;
+    long numFlowsClosed = 0;
+
+protected:
+    virtual int numInitStages() const override { return NUM_INIT_STAGES; }
+    virtual void initialize(int stage) override;
+    virtual void handleMessageWhenUp(cMessage *msg) override;
+    virtual void finish() override;
+
+    virtual void readCdfFile(const char *fileName);
+    virtual long drawFlowSize();
+    virtual double getLinkDatarate();
+    virtual void scheduleNextArrival();
+    virtual void startFlow();
+    virtual Packet *createDataPacket(const Flow& flow);
+    virtual void removeSocket(TcpSocket *socket);
+
+    virtual void socketDataArrived(TcpSocket *socket, Packet *packet, bool urgent) override { delete packet; }
+    virtual void socketAvailable(TcpSocket *socket, TcpAvailableInfo *availableInfo) override { socket->accept(availableInfo->getNewSocketId()); }
+    virtual void socketEstablished(TcpSocket *socket) override;
+    virtual void socketPeerClosed(TcpSocket *socket) override;
+    virtual void socketClosed(TcpSocket *socket) override;
+    virtual void socketFailure(TcpSocket *socket, int code) override;
+    virtual void socketStatusArrived(TcpSocket *socket, TcpStatusInfo *status) override {}
+    virtual void socketDeleted(TcpSocket *socket) override {}
+
+    virtual void handleStartOperation(LifecycleOperation *operation) override;
+    virtual void handleStopOperation(LifecycleOperation *operation) override;
+    virtual void handleCrashOperation(LifecycleOperation *operation) override;
+
+public:
+    virtual ~HpccWorkloadApp();
+
+    /**
+     * Starts a flow of flowSize bytes to connectAddress now, used by traffic managers such as HpccTraceReplayer.
+     */
+    virtual void startFlow(const L3Address& connectAddress, long flowSize);
+};
+
+} // namespace inet
+
+#endif
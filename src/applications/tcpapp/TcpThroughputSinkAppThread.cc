@@ -13,6 +13,12 @@
 // along with this program.  If not, see http://www.gnu.org/licenses/.
 // 
 
+#include <inet/common/TimeTag_m.h>
+
+#include "../../common/DeadlineTag_m.h"
+
+#include "HpccSinkApp.h"
+#include "HpccThroughputSampler.h"
 #include "TcpThroughputSinkAppThread.h"
 
 Define_Module(TcpThroughputSinkAppThread);
@@ -29,6 +35,11 @@ void TcpThroughputSinkAppThread::initialize(int stage) {
 
         lastBytesReceived = 0;
         oldLastBytesReceived = 0;
+
+        //The path is relative to the network, e.g. "throughputSampler"
+        const char *throughputSamplerModule = par("throughputSamplerModule");
+        if (*throughputSamplerModule != '\0')
+            throughputSampler = check_and_cast<HpccThroughputSampler *>(getSimulation()->getSystemModule()->getModuleByPath((std::string(".") + throughputSamplerModule).c_str()));
     }
 
 }
@@ -53,6 +64,11 @@ void TcpThroughputSinkAppThread::handleMessage(cMessage *message) {
 void TcpThroughputSinkAppThread::established() {
     TcpSinkAppThread::established();
 
+    if (throughputSampler != nullptr) {
+        throughputSampler->registerThread(this, bytesRcvd);
+        return;
+    }
+
     lastThroughputTime = simTime();
     oldlastThroughputTime = simTime();
 
@@ -62,6 +78,15 @@ void TcpThroughputSinkAppThread::established() {
 
 }
 
+void TcpThroughputSinkAppThread::dataArrived(Packet *packet, bool urgent) {
+    for (auto& region : packet->peekData()->getAllTags<CreationTimeTag>())
+        flowStartTime = std::min(flowStartTime, region.getTag()->getCreationTime());
+    for (auto& region : packet->peekData()->getAllTags<DeadlineTag>())
+        flowDeadline = std::max(flowDeadline, region.getTag()->getDeadline());
+    lastDataArrivalTime = simTime();
+    TcpSinkAppThread::dataArrived(packet, urgent);
+}
+
 long TcpThroughputSinkAppThread::computeThroughput(bool peerClosed) {
     long thr;
     if (!peerClosed) {
@@ -77,16 +102,37 @@ long TcpThroughputSinkAppThread::computeThroughput(bool peerClosed) {
     return thr;
 }
 
+void TcpThroughputSinkAppThread::emitThroughput(double throughput) {
+    Enter_Method_Silent();
+    emit(throughputReceiverSignal, throughput);
+}
+
 void TcpThroughputSinkAppThread::peerClosed() {
     TcpSinkAppThread::peerClosed();
     EV_TRACE << "Peer closed" << std::endl;
-    long thr = computeThroughput(true);
-    lastBytesReceived = bytesRcvd;
-    lastThroughputTime = simTime();
+    if (throughputSampler != nullptr)
+        throughputSampler->unregisterThread(this);
+    else {
+        long thr = computeThroughput(true);
+        lastBytesReceived = bytesRcvd;
+        lastThroughputTime = simTime();
+
+        emit(throughputReceiverSignal, thr);
+        if (throughputTimer->isScheduled()) {
+            cancelEvent(throughputTimer);
+        }
+    }
 
-    emit(throughputReceiverSignal, thr);
-    if (throughputTimer->isScheduled()) {
-        cancelEvent(throughputTimer);
+    //Only HpccSinkApp collects flow completion times, and only flows with tagged payload have a known start
+    HpccSinkApp *sinkApp = dynamic_cast<HpccSinkApp *>(getParentModule());
+    if (sinkApp != nullptr && bytesRcvd > 0 && flowStartTime != SIMTIME_MAX) {
+        HpccSinkApp::FlowRecord flow;
+        flow.flowId = sock->getSocketId();
+        flow.size = bytesRcvd;
+        flow.startTime = flowStartTime;
+        flow.completionTime = lastDataArrivalTime;
+        flow.deadline = flowDeadline;
+        sinkApp->flowCompleted(flow);
     }
 
 }
@@ -21,6 +21,8 @@
 using namespace omnetpp;
 using namespace inet;
 
+namespace inet { class HpccThroughputSampler; }
+
 
 class TcpThroughputSinkAppThread : public TcpSinkAppThread
 {
@@ -43,10 +45,20 @@ private:
     double thrMeasurementInterval;
     int thrMeasurementBandwidth;
 
+    //Earliest payload CreationTimeTag and arrival of the last data of the flow, reported to HpccSinkApp on peerClosed()
+    simtime_t flowStartTime = SIMTIME_MAX;
+    simtime_t lastDataArrivalTime;
+    //Latest DeadlineTag of the payload, -1 if the flow has no deadline
+    simtime_t flowDeadline = -1;
+
+    //Shared sampler that replaces throughputTimer, if throughputSamplerModule is set
+    HpccThroughputSampler *throughputSampler = nullptr;
+
 protected:
     virtual void initialize(int stage) override;
     virtual long computeThroughput(bool peerClosed);
     virtual void established() override;
+    virtual void dataArrived(Packet *packet, bool urgent) override;
 
     //Althout the parent class provided a timerExpired API, there was an issue with ownership of the message when calling scheduleEvent() from hostmod.
     virtual void handleMessage(cMessage *message) override;
@@ -55,6 +67,9 @@ protected:
 public:
     virtual ~TcpThroughputSinkAppThread();
 
+    long getBytesReceived() const { return bytesRcvd; }
+    //Called by HpccThroughputSampler with the throughput of its last sampling interval
+    virtual void emitThroughput(double throughput);
 
 };
 
@@ -0,0 +1,67 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "LogHistogram.h"
+
+namespace inet {
+
+void initializeLogHistogram(cHistogram& histogram, const char *name, double min, double max)
+{
+    std::vector<double> binEdges;
+    for (double edge = min; edge < max; edge *= std::pow(2.0, 0.25))
+        binEdges.push_back(edge);
+    binEdges.push_back(max);
+    histogram.setName(name);
+    histogram.setStrategy(nullptr);
+    histogram.setBinEdges(binEdges);
+}
+
+double computeLogHistogramPercentile(const cHistogram& histogram, double quantile)
+{
+    double target = quantile * histogram.getCount();
+    double cumulative = histogram.getNumUnderflows();
+    if (histogram.getCount() == 0)
+        return 0;
+    if (cumulative >= target)
+        return histogram.getMin();
+    for (int i = 0; i < histogram.getNumBins(); i++) {
+        double binValue = histogram.getBinValue(i);
+        if (cumulative + binValue >= target) {
+            // interpolate geometrically inside the bin, bins are log-spaced
+            double fraction = binValue > 0 ? (target - cumulative) / binValue : 1;
+            double lower = histogram.getBinEdge(i);
+            double upper = histogram.getBinEdge(i + 1);
+            return std::min(lower * std::pow(upper / lower, fraction), histogram.getMax());
+        }
+        cumulative += binValue;
+    }
+    return histogram.getMax();
+}
+
+void recordLogHistogram(cComponent *component, cHistogram& histogram, const char *scalarPrefix)
+{
+    std::string name = scalarPrefix;
+    histogram.record();
+    component->recordScalar((name + ":p50").c_str(), computeLogHistogramPercentile(histogram, 0.5));
+    component->recordScalar((name + ":p99").c_str(), computeLogHistogramPercentile(histogram, 0.99));
+    component->recordScalar((name + ":p999").c_str(), computeLogHistogramPercentile(histogram, 0.999));
+    component->recordScalar((name + ":max").c_str(), histogram.getCount() > 0 ? histogram.getMax() : 0);
+}
+
+} // namespace inet
@@ -0,0 +1,43 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+
+#ifndef COMMON_LOGHISTOGRAM_H_
+#define COMMON_LOGHISTOGRAM_H_
+
+#include <inet/common/INETDefs.h>
+
+namespace inet {
+
+/**
+ * Sets up a histogram with logarithmically growing bins (four per octave) between min and max,
+ * which keeps percentiles within ~20% over many orders of magnitude with a few dozen bins.
+ * Samples outside the range end up in the underflow/overflow counters.
+ */
+void initializeLogHistogram(cHistogram& histogram, const char *name, double min, double max);
+
+/**
+ * Percentile of a histogram set up by initializeLogHistogram(), interpolated geometrically inside the bin.
+ */
+double computeLogHistogramPercentile(const cHistogram& histogram, double quantile);
+
+/**
+ * Records the histogram and its p50/p99/p999/max as scalars of the component, named e.g. "<scalarPrefix>:p99".
+ */
+void recordLogHistogram(cComponent *component, cHistogram& histogram, const char *scalarPrefix);
+
+} // namespace inet
+
+#endif
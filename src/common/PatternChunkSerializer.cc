@@ -0,0 +1,61 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include <algorithm>
+#include <inet/common/packet/serializer/ChunkSerializerRegistry.h>
+
+#include "PatternChunk_m.h"
+#include "PatternChunkSerializer.h"
+
+namespace inet {
+
+Register_Serializer(PatternChunk, PatternChunkSerializer);
+
+void PatternChunkSerializer::serialize(MemoryOutputStream& stream, const Ptr<const Chunk>& chunk, b offset, b length) const
+{
+    const auto& patternChunk = staticPtrCast<const PatternChunk>(chunk);
+    B chunkLength = patternChunk->getChunkLength();
+    uint64_t begin = B(offset).get();
+    uint64_t end = length == b(-1) ? chunkLength.get() : B(offset + length).get();
+    if (end > (uint64_t)chunkLength.get())
+        throw cRuntimeError("Cannot serialize beyond the end of the pattern chunk");
+    // one period of the pattern, written in blocks starting at the right phase
+    uint8_t period[512];
+    for (int i = 0; i < 512; i++)
+        period[i] = i & 0xFF;
+    for (uint64_t position = begin; position < end;) {
+        size_t phase = (patternChunk->getStreamOffset() + position) & 0xFF;
+        size_t count = std::min<uint64_t>(end - position, 256);
+        stream.writeBytes(period + phase, B(count));
+        position += count;
+    }
+}
+
+const Ptr<Chunk> PatternChunkSerializer::deserialize(MemoryInputStream& stream, const std::type_info& typeInfo) const
+{
+    auto patternChunk = makeShared<PatternChunk>();
+    B length = B(stream.getRemainingLength());
+    patternChunk->setChunkLength(length);
+    if (length == B(0))
+        return patternChunk;
+    uint8_t first = stream.readByte();
+    patternChunk->setStreamOffset(first);
+    for (uint64_t i = 1; i < (uint64_t)length.get(); i++)
+        if (stream.readByte() != ((first + i) & 0xFF))
+            patternChunk->markIncorrect();
+    return patternChunk;
+}
+
+} // namespace inet
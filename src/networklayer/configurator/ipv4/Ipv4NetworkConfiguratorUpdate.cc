@@ -14,7 +14,24 @@
 // 
 
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <queue>
 #include <set>
+#include <thread>
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "inet/common/INETUtils.h"
 #include "inet/common/ModuleAccess.h"
@@ -77,7 +94,15 @@ using namespace inet::physicallayer;
  * the past graph topology and node routing tables. Step 1, 2, 4, 5 and 6 are then repeated for the entire length of the simulation. The
  * IP addresses are not reconfigured as they have already been set for each node.
  */
-
+
+Ipv4NetworkConfiguratorUpdate::~Ipv4NetworkConfiguratorUpdate()
+{
+    for (auto& entry : ecmpHooks)
+        delete entry.second;
+    cancelAndDelete(failureDetectionTimer);
+    closeRouteSchedule();
+}
+
 void Ipv4NetworkConfiguratorUpdate::initialize(int stage)
 {
     timerInterval = par("updateInterval"); //Obtain the update interval from the INI file.
@@ -85,7 +110,8 @@ void Ipv4NetworkConfiguratorUpdate::initialize(int stage)
         cancelAndDelete(timer);
     }
     timer = new cMessage("TopologyTimer");
-    scheduleAt(0 + timerInterval, timer);  //Schedule reinvoking process.
+    if (!par("reconfigureOnTopologyChange").boolValue() && strcmp(par("routeScheduleMode").stringValue(), "replay"))
+        scheduleAt(0 + timerInterval, timer);  //Schedule reinvoking process.
     L3NetworkConfiguratorBase::initialize(stage);
     if (stage == INITSTAGE_LOCAL) {
         assignAddressesParameter = par("assignAddresses");
@@ -96,30 +122,196 @@ void Ipv4NetworkConfiguratorUpdate::initialize(int stage)
         addDefaultRoutesParameter = par("addDefaultRoutes");
         addDirectRoutesParameter = par("addDirectRoutes");
         optimizeRoutesParameter = par("optimizeRoutes");
+        reconfigureOnTopologyChange = par("reconfigureOnTopologyChange");
+        reconfigurationHoldDown = par("reconfigurationHoldDown");
+        incrementalUpdate = par("incrementalUpdate");
+        ecmp = par("ecmp");
+        if (ecmp && !incrementalUpdate)
+            throw cRuntimeError("ecmp requires incrementalUpdate, equal-cost next hops are only known to our own shortest path trees");
+        const char *loadBalancing = par("loadBalancing");
+        if (!strcmp(loadBalancing, "flowlet"))
+            flowletSwitching = true;
+        else if (strcmp(loadBalancing, "hash"))
+            throw cRuntimeError("Unknown loadBalancing '%s', must be 'hash' or 'flowlet'", loadBalancing);
+        fastReroute = par("fastReroute");
+        if (fastReroute && !incrementalUpdate)
+            throw cRuntimeError("fastReroute requires incrementalUpdate, loop-free alternates are computed from our own shortest path trees");
+        failureDetectionTime = par("failureDetectionTime");
+        if (fastReroute && failureDetectionTimer == nullptr)
+            failureDetectionTimer = new cMessage("FailureDetectionTimer");
+        flowletTimeout = par("flowletTimeout");
+        utilizationTimeConstant = par("utilizationTimeConstant");
+        if (par("numRoutingThreads").intValue() < 0)
+            throw cRuntimeError("numRoutingThreads cannot be negative");
+        numRoutingThreads = par("numRoutingThreads").intValue();
+        if (numRoutingThreads == 0)
+            numRoutingThreads = std::max(1u, std::thread::hardware_concurrency());
+        if (incrementalUpdate)
+            addStaticRoutesParameter = false; // routes come from our own shortest path trees, see ensureShortestPathTreesComputed()
+        const char *routeScheduleModeString = par("routeScheduleMode");
+        if (!strcmp(routeScheduleModeString, "record"))
+            routeScheduleMode = ROUTE_SCHEDULE_RECORD;
+        else if (!strcmp(routeScheduleModeString, "replay"))
+            routeScheduleMode = ROUTE_SCHEDULE_REPLAY;
+        else if (strcmp(routeScheduleModeString, ""))
+            throw cRuntimeError("Unknown routeScheduleMode '%s', must be '', 'record' or 'replay'", routeScheduleModeString);
+        routeScheduleFile = par("routeScheduleFile").stdstringValue();
+        configurationCacheFile = par("configurationCacheFile").stdstringValue();
+        congestionWeight = par("congestionWeight");
+        congestionSmoothing = par("congestionSmoothing");
+        congestionHysteresis = par("congestionHysteresis");
+        if (congestionWeight > 0 && (reconfigureOnTopologyChange || routeScheduleMode == ROUTE_SCHEDULE_REPLAY))
+            throw cRuntimeError("congestionWeight needs the periodic updates, it cannot be combined with reconfigureOnTopologyChange or replaying a route schedule");
+        if (routeScheduleMode == ROUTE_SCHEDULE_REPLAY) {
+            if (incrementalUpdate || reconfigureOnTopologyChange)
+                throw cRuntimeError("routeScheduleMode 'replay' cannot be combined with incrementalUpdate or reconfigureOnTopologyChange");
+            addStaticRoutesParameter = false; // routes come from the schedule, see ensureRouteScheduleReplayed()
+            openRouteSchedule();
+        }
     }
     else if (stage == INITSTAGE_NETWORK_CONFIGURATION)
         ensureConfigurationComputed(topology);
-    else if (stage == INITSTAGE_LAST)
+    else if (stage == INITSTAGE_LAST) {
         dumpConfiguration();
+        if (reconfigureOnTopologyChange || fastReroute)
+            getSimulation()->getSystemModule()->subscribe(POST_MODEL_CHANGE, this);
+        if (routeScheduleMode == ROUTE_SCHEDULE_RECORD)
+            recordRouteScheduleEpoch();
+        else if (routeScheduleMode == ROUTE_SCHEDULE_REPLAY && nextEpoch < epochTimes.size())
+            scheduleAt(epochTimes[nextEpoch], timer);
+    }
+}
+
+void Ipv4NetworkConfiguratorUpdate::finish()
+{
+    if (routeScheduleMode == ROUTE_SCHEDULE_RECORD) {
+        routeScheduleStream.flush();
+        recordScalar("recordedRouteEpochs", numRecordedEpochs);
+    }
+    if (reconfigureOnTopologyChange) {
+        recordScalar("topologyChangeNotifications", numTopologyChangeNotifications);
+        recordScalar("reconfigurations", numReconfigurations);
+    }
+    if (fastReroute) {
+        long numReroutedPackets = 0;
+        for (auto& entry : ecmpHooks) {
+            if (entry.second != nullptr)
+                numReroutedPackets += entry.second->getNumReroutedPackets();
+        }
+        recordScalar("reroutedPackets", numReroutedPackets);
+    }
+    if (ecmp && flowletSwitching) {
+        long numFlowlets = 0, numFlowletSwitches = 0;
+        for (auto& entry : ecmpHooks) {
+            if (entry.second != nullptr) {
+                numFlowlets += entry.second->getNumFlowlets();
+                numFlowletSwitches += entry.second->getNumFlowletSwitches();
+            }
+        }
+        recordScalar("flowlets", numFlowlets);
+        recordScalar("flowletSwitches", numFlowletSwitches);
+    }
+}
+
+/**
+ * With reconfigureOnTopologyChange, model change notifications replace the periodic timer. The routes are not
+ * recomputed from within the notification, as the change may still be in progress (e.g. ScenarioManager disconnects
+ * both directions of a link one after the other). Instead the timer is scheduled after the hold-down, so every change
+ * arriving until then is handled by a single reconfiguration.
+ */
+void Ipv4NetworkConfiguratorUpdate::receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details)
+{
+    Enter_Method_Silent();
+    if (signalID != POST_MODEL_CHANGE)
+        return;
+    if (fastReroute) {
+        // the node notices the failure of its own link after failureDetectionTime and switches to the backups locally
+        if (auto gateDisconnectNotification = dynamic_cast<cPostGateDisconnectNotification *>(obj)) {
+            GateKey gate(gateDisconnectNotification->gate->getOwnerModule()->getId(), gateDisconnectNotification->gate->getId());
+            if (failureDetectionTime == 0)
+                setInterfaceFailed(gate, true);
+            else {
+                pendingFailures.insert(std::make_pair(simTime() + failureDetectionTime, gate));
+                if (!failureDetectionTimer->isScheduled())
+                    scheduleAt(pendingFailures.begin()->first, failureDetectionTimer);
+            }
+        }
+        else if (auto gateConnectNotification = dynamic_cast<cPostGateConnectNotification *>(obj))
+            setInterfaceFailed(GateKey(gateConnectNotification->gate->getOwnerModule()->getId(), gateConnectNotification->gate->getId()), false);
+    }
+    if (!reconfigureOnTopologyChange || !isTopologyChange(obj))
+        return;
+    numTopologyChangeNotifications++;
+    if (!timer->isScheduled())
+        scheduleAt(simTime() + reconfigurationHoldDown, timer);
+}
+
+/**
+ * Connecting or disconnecting a gate of a network node, or changing a parameter of a channel between network nodes,
+ * can change the routes. Everything else (e.g. parameter changes of applications) is ignored.
+ */
+bool Ipv4NetworkConfiguratorUpdate::isTopologyChange(cObject *notification)
+{
+    if (auto gateConnectNotification = dynamic_cast<cPostGateConnectNotification *>(notification))
+        return isNetworkNode(gateConnectNotification->gate->getOwnerModule());
+    else if (auto gateDisconnectNotification = dynamic_cast<cPostGateDisconnectNotification *>(notification))
+        return isNetworkNode(gateDisconnectNotification->gate->getOwnerModule());
+    else if (auto parameterChangeNotification = dynamic_cast<cPostParameterChangeNotification *>(notification)) {
+        cChannel *channel = dynamic_cast<cChannel *>(parameterChangeNotification->par->getOwner());
+        return channel != nullptr && channel->getSourceGate() != nullptr && isNetworkNode(channel->getSourceGate()->getOwnerModule());
+    }
+    return false;
 }
 
 /**
  * This method handles the timer that calls the reinvoking process. Once the routes have again been determined
- * the timer is rescheduled.
+ * the timer is rescheduled, unless reconfiguration is driven by topology change notifications.
  */
 void Ipv4NetworkConfiguratorUpdate::handleMessage(cMessage *msg)
 {
-    if (msg == timer) {
-        cXMLElementList autorouteElements = configuration->getChildrenByTagName("autoroute");
-                if (autorouteElements.size() == 0) {
-                    cXMLElement defaultAutorouteElement("autoroute", "", nullptr);
-                    Ipv4NetworkConfiguratorUpdate::reinvokeConfigurator(topology, &defaultAutorouteElement);
-                }
-                else {
-                    for (auto & autorouteElement : autorouteElements)
-                        Ipv4NetworkConfiguratorUpdate::reinvokeConfigurator(topology, autorouteElement);
-                }
-       scheduleAt(simTime() + timerInterval, timer);  // rescheduling
+    if (msg == failureDetectionTimer) {
+        while (!pendingFailures.empty() && pendingFailures.begin()->first <= simTime()) {
+            setInterfaceFailed(pendingFailures.begin()->second, true);
+            pendingFailures.erase(pendingFailures.begin());
+        }
+        if (!pendingFailures.empty())
+            scheduleAt(pendingFailures.begin()->first, failureDetectionTimer);
+    }
+    else if (msg == timer && routeScheduleMode == ROUTE_SCHEDULE_REPLAY) {
+        std::vector<Node *> changedNodes;
+        while (nextEpoch < epochTimes.size() && epochTimes[nextEpoch] <= simTime())
+            replayRouteScheduleEpoch(nextEpoch++, changedNodes);
+        for (auto node : changedNodes)
+            configureRoutingTable(node);
+        if (nextEpoch < epochTimes.size())
+            scheduleAt(epochTimes[nextEpoch], timer);
+    }
+    else if (msg == timer) {
+        reconfigure();
+        if (routeScheduleMode == ROUTE_SCHEDULE_RECORD)
+            recordRouteScheduleEpoch();
+        if (!reconfigureOnTopologyChange)
+            scheduleAt(simTime() + timerInterval, timer);  // rescheduling
+    }
+}
+
+void Ipv4NetworkConfiguratorUpdate::reconfigure()
+{
+    numReconfigurations++;
+    if (congestionWeight > 0)
+        updateLinkLoads();
+    cXMLElementList autorouteElements = configuration->getChildrenByTagName("autoroute");
+    if (incrementalUpdate) {
+        cXMLElement defaultAutorouteElement("autoroute", "", nullptr);
+        reinvokeConfiguratorIncrementally(topology, getFirstAutorouteElement(defaultAutorouteElement));
+    }
+    else if (autorouteElements.size() == 0) {
+        cXMLElement defaultAutorouteElement("autoroute", "", nullptr);
+        Ipv4NetworkConfiguratorUpdate::reinvokeConfigurator(topology, &defaultAutorouteElement);
+    }
+    else {
+        for (auto & autorouteElement : autorouteElements)
+            Ipv4NetworkConfiguratorUpdate::reinvokeConfigurator(topology, autorouteElement);
     }
 }
 
@@ -136,35 +328,902 @@ void Ipv4NetworkConfiguratorUpdate::handleMessage(cMessage *msg)
  */
 void Ipv4NetworkConfiguratorUpdate::reinvokeConfigurator(Topology& topology, cXMLElement *autorouteElement)
 {
+    // unicast routes are not flushed here: configureRoutingTable(Node *) diffs them against the new static routes
     for (int i = 0; i < topology.getNumNodes(); i++) {
         Node *node = (Node *)topology.getNode(i);
-        //std::for_each(node->interfaceInfos.begin(), node->interfaceInfos.end(), [](InterfaceInfo* interface) { delete interface; });
-        //for( auto & p : node->interfaceInfos ) delete p;
-        node->interfaceInfos.clear();
-        Ipv4RoutingTable *routingTable = dynamic_cast<Ipv4RoutingTable*>(node->routingTable);
-        for(int j = 0; j < routingTable->getNumRoutes(); j++){
-            //delete node->routingTable->routes;
-            //Ipv4RoutingTable *routingTable = dynamic_cast<Ipv4RoutingTable*>(node->routingTable); //TO DO, change it so it isnt restricted to ipv4
-            bool check = routingTable->deleteRoute(routingTable->getRoute(j));
-            EV_DEBUG << check;
-        }
-        for(int m = 0; m < node->routingTable->getNumMulticastRoutes(); m++){
+        for (int m = node->routingTable->getNumMulticastRoutes() - 1; m >= 0; m--)
             node->routingTable->deleteMulticastRoute(node->routingTable->getMulticastRoute(m));
+    }
+    clearTopology(topology);
+    extractTopology(topology);
+    addStaticRoutes(topology, autorouteElement);
+    Ipv4NetworkConfiguratorUpdate::configureAllRoutingTables();
+}
+
+/**
+ * Incremental counterpart of reinvokeConfigurator, used when incrementalUpdate is set. The output gates of all
+ * network nodes are compared against the snapshot taken on the previous run. If nothing changed, the routing tables
+ * are left alone. Otherwise the topology is extracted again and only the shortest path trees that used a changed
+ * link, or that a changed link can now shorten, are recomputed; their routes are updated in place.
+ */
+void Ipv4NetworkConfiguratorUpdate::reinvokeConfiguratorIncrementally(Topology& topology, cXMLElement *autorouteElement)
+{
+    ensureShortestPathTreesComputed();
+    TopologySnapshot snapshot;
+    takeTopologySnapshot(topology, snapshot);
+    if (snapshot == topologySnapshot) {
+        EV_INFO << "Topology unchanged, keeping all routes.\n";
+        return;
+    }
+    std::set<GateKey> changedGates;
+    for (auto& entry : snapshot) {
+        auto it = topologySnapshot.find(entry.first);
+        if (it == topologySnapshot.end() || it->second != entry.second)
+            changedGates.insert(entry.first);
+    }
+    for (auto& entry : topologySnapshot) {
+        if (snapshot.find(entry.first) == snapshot.end())
+            changedGates.insert(entry.first);
+    }
+    topologySnapshot = snapshot;
+
+    clearTopology(topology);
+    extractTopology(topology);
+    RoutingGraph graph;
+    buildRoutingGraph(topology, autorouteElement, graph);
+    bool sameNodes = graph.moduleIds == treeModuleIds;
+    if (!sameNodes) {
+        treeModuleIds = graph.moduleIds;
+        shortestPathTrees.assign(graph.nodes.size(), ShortestPathTree());
+    }
+    std::vector<int> destinations;
+    for (size_t i = 0; i < graph.nodes.size(); i++) {
+        if (!sameNodes || isShortestPathTreeAffected(graph, shortestPathTrees[i], changedGates))
+            destinations.push_back(i);
+    }
+    computeShortestPathTrees(graph, destinations);
+    for (int destination : destinations)
+        installRoutesTowards(graph, shortestPathTrees[destination]);
+    if (fastReroute) {
+        // the alternates towards unaffected destinations depend on the distances between other nodes too
+        for (auto& tree : shortestPathTrees)
+            installBackupNextHopsTowards(graph, tree);
+    }
+    EV_INFO << changedGates.size() << " gates changed, recomputed " << destinations.size() << " of " << graph.nodes.size() << " shortest path trees.\n";
+}
+
+/**
+ * Measures the utilization of every link since the previous reconfiguration from the IntQueue of its source
+ * interface, as txRate / B + qLen / (B * T) with T the time since the previous measurement, and smooths it with an
+ * EWMA. A link's applied utilization, which enters its weight, only follows once it differs by more than
+ * congestionHysteresis, so that routes do not flap between two similarly loaded paths.
+ */
+void Ipv4NetworkConfiguratorUpdate::updateLinkLoads()
+{
+    simtime_t now = simTime();
+    for (int i = 0; i < topology.getNumNodes(); i++) {
+        Node *node = (Node *)topology.getNode(i);
+        for (int j = 0; j < node->getNumOutLinks(); j++) {
+            Link *link = (Link *)node->getLinkOut(j);
+            cGate *gate = link->getLinkOutLocalGate();
+            NetworkInterface *networkInterface = link->sourceInterfaceInfo->networkInterface;
+            auto queue = dynamic_cast<queueing::IntQueue *>(networkInterface->getSubmodule("queue"));
+            if (queue == nullptr || networkInterface->getDatarate() <= 0)
+                continue;
+            auto result = linkLoads.insert(std::make_pair(GateKey(gate->getOwnerModule()->getId(), gate->getId()), LinkLoad()));
+            LinkLoad& linkLoad = result.first->second;
+            if (!result.second && now > linkLoad.lastUpdate) {
+                double interval = (now - linkLoad.lastUpdate).dbl();
+                double utilization = ((queue->getTxBytes() - linkLoad.lastTxBytes) * 8 / interval + queue->getTotalLength().get() / interval) / networkInterface->getDatarate();
+                linkLoad.utilization = (1 - congestionSmoothing) * linkLoad.utilization + congestionSmoothing * utilization;
+                if (std::abs(linkLoad.utilization - linkLoad.appliedUtilization) > congestionHysteresis)
+                    linkLoad.appliedUtilization = linkLoad.utilization;
+            }
+            linkLoad.lastTxBytes = queue->getTxBytes();
+            linkLoad.lastUpdate = now;
         }
-        //routingTable->Ipv4RoutingTable;
+    }
+}
+
+/**
+ * Scales the weight of the metric by 1 + congestionWeight * applied utilization of the link, for both our own
+ * shortest path trees and INET's addStaticRoutes.
+ */
+double Ipv4NetworkConfiguratorUpdate::computeLinkWeight(Link *link, const char *metric, cXMLElement *parameters)
+{
+    double weight = Ipv4NetworkConfigurator::computeLinkWeight(link, metric, parameters);
+    if (congestionWeight > 0) {
+        cGate *gate = link->getLinkOutLocalGate();
+        auto it = linkLoads.find(GateKey(gate->getOwnerModule()->getId(), gate->getId()));
+        if (it != linkLoads.end())
+            weight *= 1 + congestionWeight * it->second.appliedUtilization;
+    }
+    return weight;
+}
+
+/**
+ * Releases everything extractTopology builds so that it can be called again. Routing tables are not touched.
+ */
+void Ipv4NetworkConfiguratorUpdate::clearTopology(Topology& topology)
+{
+    for (int i = 0; i < topology.getNumNodes(); i++) {
+        Node *node = (Node *)topology.getNode(i);
+        node->interfaceInfos.clear();
         std::for_each(node->staticRoutes.begin(), node->staticRoutes.end(), []( Ipv4Route* route) { delete route; });
-                //for every route, pop each route off.
         node->staticRoutes.clear();
     }
     std::for_each(topology.linkInfos.begin(), topology.linkInfos.end(), []( LinkInfo* link) { delete link; });
-    //std::for_each(topology.interfaceInfos.begin(), topology.interfaceInfos.end(), [](map::iterator iter) { delete (*iter).second; });
     for( auto & p : topology.interfaceInfos ) delete p.second;
     topology.linkInfos.clear();
     topology.interfaceInfos.clear();
     topology.clear();
+}
+
+/**
+ * Records where every output gate of every network node leads and the parameters of its channel. This is cheap
+ * compared to extracting the topology, and covers what ScenarioManager changes: connections and channel parameters.
+ */
+void Ipv4NetworkConfiguratorUpdate::takeTopologySnapshot(Topology& topology, TopologySnapshot& snapshot)
+{
+    snapshot.clear();
+    for (int i = 0; i < topology.getNumNodes(); i++) {
+        cModule *module = topology.getNode(i)->getModule();
+        for (cModule::GateIterator it(module); !it.end(); ++it) {
+            cGate *gate = *it;
+            if (gate->getType() != cGate::OUTPUT)
+                continue;
+            GateState& gateState = snapshot[GateKey(module->getId(), gate->getId())];
+            if (gate->getNextGate() != nullptr)
+                gateState.remoteModuleId = gate->getNextGate()->getOwnerModule()->getId();
+            if (auto channel = dynamic_cast<cDatarateChannel *>(gate->getChannel())) {
+                gateState.delay = channel->getDelay().dbl();
+                gateState.datarate = channel->getDatarate();
+                gateState.disabled = channel->isDisabled();
+            }
+            auto it = linkLoads.find(GateKey(module->getId(), gate->getId()));
+            if (it != linkLoads.end())
+                gateState.load = it->second.appliedUtilization;
+        }
+    }
+}
+
+/**
+ * Copies the extracted topology into a RoutingGraph, computing link weights with the metric of the autoroute element
+ * the same way addStaticRoutes does. Disabled links are left out.
+ */
+void Ipv4NetworkConfiguratorUpdate::buildRoutingGraph(Topology& topology, cXMLElement *autorouteElement, RoutingGraph& graph)
+{
+    const char *metric = autorouteElement->getAttribute("metric");
+    if (metric == nullptr)
+        metric = "hopCount";
+    int numNodes = topology.getNumNodes();
+    for (int i = 0; i < numNodes; i++) {
+        Node *node = (Node *)topology.getNode(i);
+        graph.nodes.push_back(node);
+        graph.moduleIds.push_back(node->getModule()->getId());
+        graph.nodeIndexByModuleId[node->getModule()->getId()] = i;
+        graph.forwarding.push_back(node->routingTable != nullptr && node->routingTable->isForwardingEnabled());
+    }
+    std::vector<std::vector<RoutingGraph::Edge>> inEdges(numNodes);
+    for (int i = 0; i < numNodes; i++) {
+        Node *node = graph.nodes[i];
+        for (int j = 0; j < node->getNumOutLinks(); j++) {
+            Link *link = (Link *)node->getLinkOut(j);
+            auto it = graph.nodeIndexByModuleId.find(link->getLinkOutRemoteNode()->getModule()->getId());
+            cGate *gate = link->getLinkOutLocalGate();
+            if (it == graph.nodeIndexByModuleId.end() || !link->isEnabled() || (gate->getChannel() != nullptr && gate->getChannel()->isDisabled()))
+                continue;
+            double weight = computeLinkWeight(link, metric, autorouteElement);
+            if (std::isinf(weight))
+                continue;
+            inEdges[it->second].push_back({i, it->second, weight, GateKey(node->getModule()->getId(), gate->getId()), link});
+        }
+    }
+    graph.inEdgeOffsets.push_back(0);
+    for (int i = 0; i < numNodes; i++) {
+        for (auto& edge : inEdges[i]) {
+            graph.edgeIndexByGate[edge.gate] = graph.edges.size();
+            graph.edges.push_back(edge);
+            interfaceIdsByGate[edge.gate] = std::make_pair(graph.moduleIds[edge.from], edge.link->sourceInterfaceInfo->networkInterface->getInterfaceId());
+        }
+        graph.inEdgeOffsets.push_back(graph.edges.size());
+    }
+    std::vector<std::vector<int>> outEdges(numNodes);
+    for (size_t k = 0; k < graph.edges.size(); k++)
+        outEdges[graph.edges[k].from].push_back(k);
+    graph.outEdgeOffsets.push_back(0);
+    for (int i = 0; i < numNodes; i++) {
+        graph.outEdges.insert(graph.outEdges.end(), outEdges[i].begin(), outEdges[i].end());
+        graph.outEdgeOffsets.push_back(graph.outEdges.size());
+    }
+}
+
+/**
+ * Dijkstra grown backwards from the destination. Only the destination itself and nodes with IP forwarding enabled
+ * can be passed through, so hosts never become transit nodes.
+ */
+void Ipv4NetworkConfiguratorUpdate::computeShortestPathTree(const RoutingGraph& graph, int destination, ShortestPathTree& tree)
+{
+    typedef std::pair<double, int> QueueEntry;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+    tree.destination = destination;
+    tree.distances.assign(graph.nodes.size(), INFINITY);
+    tree.nextHopGates.assign(graph.nodes.size(), GateKey(-1, -1));
+    tree.alternativeNextHopGates.assign(ecmp ? graph.nodes.size() : 0, std::vector<GateKey>());
+    tree.distances[destination] = 0;
+    queue.push(QueueEntry(0, destination));
+    while (!queue.empty()) {
+        QueueEntry entry = queue.top();
+        queue.pop();
+        int node = entry.second;
+        if (entry.first > tree.distances[node] || (node != destination && !graph.forwarding[node]))
+            continue;
+        for (int k = graph.inEdgeOffsets[node]; k < graph.inEdgeOffsets[node + 1]; k++) {
+            const RoutingGraph::Edge& edge = graph.edges[k];
+            double distance = entry.first + edge.weight;
+            if (ecmp && !std::isinf(tree.distances[edge.from]) && isEqualCost(distance, tree.distances[edge.from])) {
+                if (edge.gate != tree.nextHopGates[edge.from])
+                    tree.alternativeNextHopGates[edge.from].push_back(edge.gate);
+            }
+            else if (distance < tree.distances[edge.from]) {
+                tree.distances[edge.from] = distance;
+                tree.nextHopGates[edge.from] = edge.gate;
+                if (ecmp)
+                    tree.alternativeNextHopGates[edge.from].clear();
+                queue.push(QueueEntry(distance, edge.from));
+            }
+        }
+    }
+}
+
+/**
+ * A tree needs to be recomputed if one of its own links changed, or if a changed link offers a node a shorter
+ * distance than it had. Checking the last changed link of any improved path is enough, so old distances suffice.
+ */
+bool Ipv4NetworkConfiguratorUpdate::isShortestPathTreeAffected(const RoutingGraph& graph, const ShortestPathTree& tree, const std::set<GateKey>& changedGates)
+{
+    if (tree.distances.size() != graph.nodes.size())
+        return true;
+    for (auto& gate : changedGates) {
+        auto nodeIt = graph.nodeIndexByModuleId.find(gate.first);
+        if (nodeIt == graph.nodeIndexByModuleId.end())
+            continue;
+        int from = nodeIt->second;
+        if (tree.nextHopGates[from] == gate)
+            return true;
+        if (ecmp && contains(tree.alternativeNextHopGates[from], gate))
+            return true;
+        auto edgeIt = graph.edgeIndexByGate.find(gate);
+        if (edgeIt != graph.edgeIndexByGate.end()) {
+            const RoutingGraph::Edge& edge = graph.edges[edgeIt->second];
+            double distance = edge.weight + tree.distances[edge.to];
+            if ((edge.to == tree.destination || graph.forwarding[edge.to]) && !std::isinf(distance)) {
+                if (tree.distances[from] > distance || (ecmp && isEqualCost(tree.distances[from], distance)))
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Points the host routes of every node towards the interfaces of the tree's destination at the next hop of the
+ * tree, and removes them from nodes that can no longer reach it.
+ */
+void Ipv4NetworkConfiguratorUpdate::installRoutesTowards(const RoutingGraph& graph, const ShortestPathTree& tree)
+{
+    Node *destinationNode = graph.nodes[tree.destination];
+    for (auto interfaceInfo : destinationNode->interfaceInfos) {
+        NetworkInterface *destinationInterface = interfaceInfo->networkInterface;
+        if (destinationInterface->isLoopback() || destinationInterface->getIpv4Address().isUnspecified())
+            continue;
+        for (size_t i = 0; i < graph.nodes.size(); i++) {
+            Node *node = graph.nodes[i];
+            if ((int)i == tree.destination || node->routingTable == nullptr)
+                continue;
+            auto it = graph.edgeIndexByGate.find(tree.nextHopGates[i]);
+            if (it == graph.edgeIndexByGate.end())
+                installRoute(node, destinationInterface->getIpv4Address(), Ipv4Address::UNSPECIFIED_ADDRESS, nullptr);
+            else {
+                Link *link = graph.edges[it->second].link;
+                installRoute(node, destinationInterface->getIpv4Address(), link->destinationInterfaceInfo->networkInterface->getIpv4Address(), link->sourceInterfaceInfo->networkInterface);
+            }
+            if (ecmp) {
+                // the route above carries the traffic the hook leaves alone, the hook spreads flows over all next hops
+                std::vector<EcmpForwardingHook::NextHop> nextHops;
+                std::vector<NetworkInterface *> egressInterfaces;
+                if (it != graph.edgeIndexByGate.end()) {
+                    std::vector<GateKey> gates = tree.alternativeNextHopGates[i];
+                    gates.insert(gates.begin(), tree.nextHopGates[i]);
+                    std::sort(gates.begin(), gates.end());
+                    for (auto& gate : gates) {
+                        Link *link = graph.edges[graph.edgeIndexByGate.at(gate)].link;
+                        nextHops.push_back({link->sourceInterfaceInfo->networkInterface->getInterfaceId(), link->destinationInterfaceInfo->networkInterface->getIpv4Address()});
+                        egressInterfaces.push_back(link->sourceInterfaceInfo->networkInterface);
+                    }
+                }
+                EcmpForwardingHook *hook = getEcmpHook(node);
+                if (hook != nullptr) {
+                    hook->setNextHops(destinationInterface->getIpv4Address(), nextHops);
+                    if (flowletSwitching && nextHops.size() > 1) {
+                        for (auto networkInterface : egressInterfaces)
+                            hook->setEgress(networkInterface->getInterfaceId(), dynamic_cast<queueing::IntQueue *>(networkInterface->getSubmodule("queue")), networkInterface->getDatarate());
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Gives every node a loop-free alternate (RFC 5286) towards the destination: a neighbor N that is not a next hop
+ * of the tree and satisfies dist(N, D) < dist(N, S) + dist(S, D), so it never sends the traffic back through S.
+ * Of those, the one with the shortest path to the destination is installed as backup into the node's hook.
+ */
+void Ipv4NetworkConfiguratorUpdate::installBackupNextHopsTowards(const RoutingGraph& graph, const ShortestPathTree& tree)
+{
+    std::vector<Ipv4Address> destinations;
+    for (auto interfaceInfo : graph.nodes[tree.destination]->interfaceInfos) {
+        NetworkInterface *destinationInterface = interfaceInfo->networkInterface;
+        if (!destinationInterface->isLoopback() && !destinationInterface->getIpv4Address().isUnspecified())
+            destinations.push_back(destinationInterface->getIpv4Address());
+    }
+    for (size_t i = 0; i < graph.nodes.size(); i++) {
+        Node *node = graph.nodes[i];
+        if ((int)i == tree.destination || node->routingTable == nullptr)
+            continue;
+        EcmpForwardingHook *hook = getEcmpHook(node);
+        if (hook == nullptr)
+            continue;
+        int primaryInterfaceId = -1;
+        EcmpForwardingHook::NextHop backupNextHop = { -1, Ipv4Address::UNSPECIFIED_ADDRESS };
+        auto it = graph.edgeIndexByGate.find(tree.nextHopGates[i]);
+        if (it != graph.edgeIndexByGate.end()) {
+            primaryInterfaceId = graph.edges[it->second].link->sourceInterfaceInfo->networkInterface->getInterfaceId();
+            double backupDistance = INFINITY;
+            for (int k = graph.outEdgeOffsets[i]; k < graph.outEdgeOffsets[i + 1]; k++) {
+                const RoutingGraph::Edge& edge = graph.edges[graph.outEdges[k]];
+                if (edge.gate == tree.nextHopGates[i] || (ecmp && contains(tree.alternativeNextHopGates[i], edge.gate)))
+                    continue;
+                if (edge.to != tree.destination && !graph.forwarding[edge.to])
+                    continue;
+                double distance = tree.distances[edge.to];
+                if (std::isinf(distance) || !(distance < shortestPathTrees[i].distances[edge.to] + tree.distances[i]))
+                    continue;
+                if (edge.weight + distance < backupDistance) {
+                    backupDistance = edge.weight + distance;
+                    backupNextHop = { edge.link->sourceInterfaceInfo->networkInterface->getInterfaceId(), edge.link->destinationInterfaceInfo->networkInterface->getIpv4Address() };
+                }
+            }
+        }
+        for (auto& destination : destinations)
+            hook->setBackupNextHop(destination, primaryInterfaceId, backupNextHop);
+    }
+}
+
+void Ipv4NetworkConfiguratorUpdate::setInterfaceFailed(const GateKey& gate, bool failed)
+{
+    auto it = interfaceIdsByGate.find(gate);
+    if (it == interfaceIdsByGate.end())
+        return;
+    auto jt = ecmpHooks.find(it->second.first);
+    if (jt != ecmpHooks.end() && jt->second != nullptr) {
+        EV_INFO << "Interface " << it->second.second << " of module " << it->second.first << (failed ? " failed" : " recovered") << ", " << (failed ? "switching to" : "leaving") << " backup next hops.\n";
+        jt->second->setInterfaceFailed(it->second.second, failed);
+    }
+}
+
+/**
+ * Adds, updates or (if networkInterface is nullptr) removes the host route this configurator owns for the destination.
+ * The route is looked up in the node's route index, which is kept in step with the additions and deletions.
+ */
+void Ipv4NetworkConfiguratorUpdate::installRoute(Node *node, Ipv4Address destination, Ipv4Address gateway, NetworkInterface *networkInterface)
+{
+    IIpv4RoutingTable *routingTable = node->routingTable;
+    RouteIndex& routeIndex = getRouteIndex(node);
+    auto it = routeIndex.find(((uint64_t)destination.getInt() << 32) | Ipv4Address::ALLONES_ADDRESS.getInt());
+    if (it != routeIndex.end()) {
+        Ipv4Route *route = it->second;
+        if (networkInterface == nullptr) {
+            routeIndex.erase(it);
+            routingTable->deleteRoute(route);
+        }
+        else {
+            if (route->getGateway() != gateway)
+                route->setGateway(gateway);
+            if (route->getInterface() != networkInterface)
+                route->setInterface(networkInterface);
+        }
+        return;
+    }
+    if (networkInterface != nullptr) {
+        Ipv4Route *route = new Ipv4Route();
+        route->setSourceType(IRoute::MANUAL);
+        route->setSource(this);
+        route->setDestination(destination);
+        route->setNetmask(Ipv4Address::ALLONES_ADDRESS);
+        route->setGateway(gateway);
+        route->setInterface(networkInterface);
+        routingTable->addRoute(route);
+        routeIndex[getRouteKey(route)] = route;
+    }
+}
+
+/**
+ * With incrementalUpdate the initial static routes are not computed by addStaticRoutes but from the shortest path
+ * trees, which are kept for the change detection of later reinvocations.
+ */
+void Ipv4NetworkConfiguratorUpdate::ensureShortestPathTreesComputed()
+{
+    if (!incrementalUpdate || !shortestPathTrees.empty())
+        return;
+    cXMLElement defaultAutorouteElement("autoroute", "", nullptr);
+    RoutingGraph graph;
+    buildRoutingGraph(topology, getFirstAutorouteElement(defaultAutorouteElement), graph);
+    takeTopologySnapshot(topology, topologySnapshot);
+    treeModuleIds = graph.moduleIds;
+    shortestPathTrees.resize(graph.nodes.size());
+    std::vector<int> destinations(graph.nodes.size());
+    std::iota(destinations.begin(), destinations.end(), 0);
+    computeShortestPathTrees(graph, destinations);
+    for (int destination : destinations)
+        installRoutesTowards(graph, shortestPathTrees[destination]);
+    if (fastReroute) {
+        for (int destination : destinations)
+            installBackupNextHopsTowards(graph, shortestPathTrees[destination]);
+    }
+}
+
+/**
+ * Computes the shortest path trees of the destinations into their slots of shortestPathTrees, using up to
+ * numRoutingThreads threads. The graph is only read and every tree is written by exactly one thread, so the result
+ * does not depend on scheduling; the routes are installed afterwards in destination order on the simulation thread.
+ */
+void Ipv4NetworkConfiguratorUpdate::computeShortestPathTrees(const RoutingGraph& graph, const std::vector<int>& destinations)
+{
+    size_t numThreads = std::min((size_t)numRoutingThreads, destinations.size());
+    if (numThreads <= 1) {
+        for (int destination : destinations)
+            computeShortestPathTree(graph, destination, shortestPathTrees[destination]);
+        return;
+    }
+    std::atomic<size_t> nextDestination(0);
+    auto worker = [&] () {
+        for (size_t i = nextDestination++; i < destinations.size(); i = nextDestination++)
+            computeShortestPathTree(graph, destinations[i], shortestPathTrees[destinations[i]]);
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; i++)
+        threads.push_back(std::thread(worker));
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+/**
+ * With a configurationCacheFile, the addresses and static routes computed before the simulation starts are reused
+ * from an earlier run if the network structure, the XML configuration and the parameters of this module are the
+ * same. Only the topology extraction, which is needed to apply them, is repeated.
+ */
+void Ipv4NetworkConfiguratorUpdate::computeConfiguration()
+{
+    if (configurationCacheFile.empty()) {
+        Ipv4NetworkConfigurator::computeConfiguration();
+        return;
+    }
+    topology.clear();
     extractTopology(topology);
-    addStaticRoutes(topology, autorouteElement);
-    Ipv4NetworkConfiguratorUpdate::configureAllRoutingTables();
+    uint64_t key = computeConfigurationKey();
+    if (loadConfigurationCache(key)) {
+        EV_INFO << "Loaded network configuration from " << configurationCacheFile << ".\n";
+        return;
+    }
+    clearTopology(topology);
+    Ipv4NetworkConfigurator::computeConfiguration();
+    saveConfigurationCache(key);
+}
+
+/**
+ * FNV-1a over everything the configuration depends on: the network nodes with their gates, where they lead and the
+ * channel parameters, the configurator XML and the parameters of this module.
+ */
+uint64_t Ipv4NetworkConfiguratorUpdate::computeConfigurationKey()
+{
+    uint64_t key = 14695981039346656037ULL;
+    auto add = [&] (const std::string& string) {
+        for (char c : string) {
+            key ^= (unsigned char)c;
+            key *= 1099511628211ULL;
+        }
+        key ^= 0xff; // separator
+        key *= 1099511628211ULL;
+    };
+    std::function<void(const cXMLElement *)> addXml = [&] (const cXMLElement *element) {
+        add(element->getTagName());
+        for (auto& attribute : element->getAttributes()) {
+            add(attribute.first);
+            add(attribute.second);
+        }
+        add(element->getNodeValue() != nullptr ? element->getNodeValue() : "");
+        for (cXMLElement *child = element->getFirstChild(); child != nullptr; child = child->getNextSibling())
+            addXml(child);
+        add("/");
+    };
+    for (int i = 0; i < topology.getNumNodes(); i++) {
+        cModule *module = topology.getNode(i)->getModule();
+        add(module->getFullPath());
+        add(module->getNedTypeName());
+        for (cModule::GateIterator it(module); !it.end(); ++it) {
+            cGate *gate = *it;
+            add(gate->getFullName());
+            if (gate->getType() != cGate::OUTPUT)
+                continue;
+            add(gate->getPathEndGate()->getFullPath());
+            if (cChannel *channel = gate->getChannel()) {
+                add(channel->getNedTypeName());
+                for (int j = 0; j < channel->getNumParams(); j++)
+                    add(channel->par(j).str());
+            }
+        }
+    }
+    addXml(configuration);
+    for (int i = 0; i < getNumParams(); i++) {
+        add(par(i).getName());
+        add(par(i).str());
+    }
+    return key;
+}
+
+/**
+ * Restores interface addresses and static routes written by saveConfigurationCache(). Returns false, leaving the
+ * topology untouched, if the file does not exist or belongs to a different key or network.
+ */
+bool Ipv4NetworkConfiguratorUpdate::loadConfigurationCache(uint64_t key)
+{
+    std::ifstream stream(configurationCacheFile, std::ios::binary);
+    if (!stream)
+        return false;
+    auto read = [&] (void *value, size_t size) { stream.read((char *)value, size); return (bool)stream; };
+    char magic[4];
+    uint32_t version, numNodes;
+    uint64_t cachedKey;
+    if (!read(magic, sizeof(magic)) || memcmp(magic, "HPNC", 4) || !read(&version, sizeof(version)) || version != 1
+            || !read(&cachedKey, sizeof(cachedKey)) || cachedKey != key || !read(&numNodes, sizeof(numNodes)) || numNodes != (uint32_t)topology.getNumNodes())
+        return false;
+    // read everything first, so that a truncated file cannot leave a half configured topology behind
+    struct CachedInterface {
+        int32_t interfaceId;
+        uint32_t address;
+        uint32_t netmask;
+        int32_t mtu;
+        double metric;
+        uint8_t configure;
+    };
+    std::vector<std::vector<CachedInterface>> interfaces(numNodes);
+    std::vector<std::vector<ScheduledRoute>> routes(numNodes);
+    for (uint32_t i = 0; i < numNodes; i++) {
+        uint32_t numInterfaces, numRoutes;
+        if (!read(&numInterfaces, sizeof(numInterfaces)) || numInterfaces != ((Node *)topology.getNode(i))->interfaceInfos.size())
+            return false;
+        for (uint32_t j = 0; j < numInterfaces; j++) {
+            interfaces[i].push_back(CachedInterface());
+            CachedInterface& interface = interfaces[i].back();
+            if (!read(&interface.interfaceId, sizeof(interface.interfaceId)) || !read(&interface.address, sizeof(interface.address)) || !read(&interface.netmask, sizeof(interface.netmask))
+                    || !read(&interface.mtu, sizeof(interface.mtu)) || !read(&interface.metric, sizeof(interface.metric)) || !read(&interface.configure, sizeof(interface.configure)))
+                return false;
+        }
+        if (!read(&numRoutes, sizeof(numRoutes)))
+            return false;
+        routes[i].resize(numRoutes);
+        if (numRoutes > 0 && !read(routes[i].data(), numRoutes * sizeof(ScheduledRoute)))
+            return false;
+    }
+    for (uint32_t i = 0; i < numNodes; i++) {
+        Node *node = (Node *)topology.getNode(i);
+        for (size_t j = 0; j < node->interfaceInfos.size(); j++) {
+            InterfaceInfo *interfaceInfo = (InterfaceInfo *)node->interfaceInfos[j];
+            const CachedInterface& interface = interfaces[i][j];
+            if (interfaceInfo->networkInterface->getInterfaceId() != interface.interfaceId)
+                throw cRuntimeError("Network configuration cache '%s' does not match %s", configurationCacheFile.c_str(), node->getModule()->getFullPath().c_str());
+            interfaceInfo->address = interface.address;
+            interfaceInfo->netmask = interface.netmask;
+            interfaceInfo->addressSpecifiedBits = 0xFFFFFFFF;
+            interfaceInfo->netmaskSpecifiedBits = 0xFFFFFFFF;
+            interfaceInfo->mtu = interface.mtu;
+            interfaceInfo->metric = interface.metric;
+            interfaceInfo->configure = interface.configure;
+        }
+        for (auto& scheduledRoute : routes[i]) {
+            Ipv4Route *route = new Ipv4Route();
+            route->setSourceType(IRoute::MANUAL);
+            route->setDestination(Ipv4Address(scheduledRoute.destination));
+            route->setNetmask(Ipv4Address(scheduledRoute.netmask));
+            route->setGateway(Ipv4Address(scheduledRoute.gateway));
+            route->setInterface(scheduledRoute.interfaceId != -1 ? node->interfaceTable->getInterfaceById(scheduledRoute.interfaceId) : nullptr);
+            route->setMetric(scheduledRoute.metric);
+            node->staticRoutes.push_back(route);
+        }
+    }
+    return true;
+}
+
+/**
+ * Writes the computed interface addresses and static routes of every node, in topology order and host byte order:
+ *
+ *   "HPNC", uint32 version (1), uint64 key, uint32 numNodes,
+ *   per node: uint32 numInterfaces, numInterfaces x (int32 interface id, uint32 address, uint32 netmask, int32 mtu,
+ *             double metric, uint8 configure), uint32 numRoutes, numRoutes x ScheduledRoute
+ */
+void Ipv4NetworkConfiguratorUpdate::saveConfigurationCache(uint64_t key)
+{
+    std::string temporaryFile = configurationCacheFile + ".tmp";
+    std::ofstream stream(temporaryFile, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+        EV_WARN << "Cannot write network configuration cache " << configurationCacheFile << ".\n";
+        return;
+    }
+    auto write = [&] (const void *value, size_t size) { stream.write((const char *)value, size); };
+    uint32_t version = 1, numNodes = topology.getNumNodes();
+    write("HPNC", 4);
+    write(&version, sizeof(version));
+    write(&key, sizeof(key));
+    write(&numNodes, sizeof(numNodes));
+    for (int i = 0; i < topology.getNumNodes(); i++) {
+        Node *node = (Node *)topology.getNode(i);
+        uint32_t numInterfaces = node->interfaceInfos.size();
+        write(&numInterfaces, sizeof(numInterfaces));
+        for (auto nodeInterfaceInfo : node->interfaceInfos) {
+            InterfaceInfo *interfaceInfo = (InterfaceInfo *)nodeInterfaceInfo;
+            int32_t interfaceId = interfaceInfo->networkInterface->getInterfaceId();
+            uint32_t address = interfaceInfo->address, netmask = interfaceInfo->netmask;
+            int32_t mtu = interfaceInfo->mtu;
+            double metric = interfaceInfo->metric;
+            uint8_t configure = interfaceInfo->configure;
+            write(&interfaceId, sizeof(interfaceId));
+            write(&address, sizeof(address));
+            write(&netmask, sizeof(netmask));
+            write(&mtu, sizeof(mtu));
+            write(&metric, sizeof(metric));
+            write(&configure, sizeof(configure));
+        }
+        uint32_t numRoutes = node->staticRoutes.size();
+        write(&numRoutes, sizeof(numRoutes));
+        for (auto route : node->staticRoutes) {
+            ScheduledRoute scheduledRoute = { route->getDestination().getInt(), route->getNetmask().getInt(), route->getGateway().getInt(), route->getInterface() != nullptr ? route->getInterface()->getInterfaceId() : -1, route->getMetric() };
+            write(&scheduledRoute, sizeof(scheduledRoute));
+        }
+    }
+    stream.close();
+    // rename, so that parallel runs of a sweep never read a partially written file
+    if (!stream || std::rename(temporaryFile.c_str(), configurationCacheFile.c_str()) != 0)
+        EV_WARN << "Cannot write network configuration cache " << configurationCacheFile << ".\n";
+}
+
+/**
+ * In replay mode, maps the schedule file written by a previous run in record mode (with mmap where available), checks
+ * its header and finds the start and time of every epoch so that no parsing is needed while the simulation runs.
+ */
+void Ipv4NetworkConfiguratorUpdate::openRouteSchedule()
+{
+#ifdef _WIN32
+    std::ifstream stream(routeScheduleFile, std::ios::binary);
+    if (!stream)
+        throw cRuntimeError("Cannot open route schedule '%s'", routeScheduleFile.c_str());
+    routeScheduleBuffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    routeSchedule = routeScheduleBuffer.data();
+    routeScheduleSize = routeScheduleBuffer.size();
+#else
+    int fd = open(routeScheduleFile.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if (fd < 0 || fstat(fd, &fileStat) < 0)
+        throw cRuntimeError("Cannot open route schedule '%s'", routeScheduleFile.c_str());
+    routeScheduleSize = fileStat.st_size;
+    void *data = routeScheduleSize > 0 ? mmap(nullptr, routeScheduleSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED)
+        throw cRuntimeError("Cannot map route schedule '%s'", routeScheduleFile.c_str());
+    routeSchedule = (const char *)data;
+#endif
+    size_t offset = 0;
+    auto read = [&] (void *value, size_t size) {
+        if (offset + size > routeScheduleSize)
+            throw cRuntimeError("Route schedule '%s' is truncated", routeScheduleFile.c_str());
+        memcpy(value, routeSchedule + offset, size);
+        offset += size;
+    };
+    char magic[4];
+    uint32_t version, numNodes;
+    read(magic, sizeof(magic));
+    read(&version, sizeof(version));
+    if (memcmp(magic, "HPRS", 4) || version != 1)
+        throw cRuntimeError("'%s' is not a route schedule written by this version", routeScheduleFile.c_str());
+    read(&numNodes, sizeof(numNodes));
+    for (uint32_t i = 0; i < numNodes; i++) {
+        uint32_t pathLength;
+        read(&pathLength, sizeof(pathLength));
+        if (offset + pathLength > routeScheduleSize)
+            throw cRuntimeError("Route schedule '%s' is truncated", routeScheduleFile.c_str());
+        scheduleNodePaths.push_back(std::string(routeSchedule + offset, pathLength));
+        offset += pathLength;
+    }
+    while (offset < routeScheduleSize) {
+        double time;
+        uint32_t numChangedNodes;
+        epochOffsets.push_back(offset);
+        read(&time, sizeof(time));
+        read(&numChangedNodes, sizeof(numChangedNodes));
+        epochTimes.push_back(time);
+        for (uint32_t i = 0; i < numChangedNodes; i++) {
+            uint32_t nodeIndex, numRoutes;
+            read(&nodeIndex, sizeof(nodeIndex));
+            read(&numRoutes, sizeof(numRoutes));
+            if (nodeIndex >= numNodes)
+                throw cRuntimeError("Route schedule '%s' is corrupt", routeScheduleFile.c_str());
+            offset += numRoutes * sizeof(ScheduledRoute);
+        }
+    }
+    if (offset != routeScheduleSize)
+        throw cRuntimeError("Route schedule '%s' is truncated", routeScheduleFile.c_str());
+    EV_INFO << "Route schedule " << routeScheduleFile << " has " << epochTimes.size() << " epochs for " << numNodes << " nodes.\n";
+}
+
+void Ipv4NetworkConfiguratorUpdate::closeRouteSchedule()
+{
+#ifndef _WIN32
+    if (routeSchedule != nullptr)
+        munmap((void *)routeSchedule, routeScheduleSize);
+#endif
+    routeSchedule = nullptr;
+    routeScheduleBuffer.clear();
+    if (routeScheduleStream.is_open())
+        routeScheduleStream.close();
+}
+
+/**
+ * Appends the routes this configurator installed to the schedule file, for the nodes whose routes changed since the
+ * previous epoch. All values are written in host byte order:
+ *
+ *   "HPRS", uint32 version (1), uint32 numNodes, numNodes x (uint32 length, full path of the node)
+ *   per epoch: double time, uint32 numChangedNodes,
+ *              numChangedNodes x (uint32 node index, uint32 numRoutes, numRoutes x ScheduledRoute)
+ */
+void Ipv4NetworkConfiguratorUpdate::recordRouteScheduleEpoch()
+{
+    if (!routeScheduleStream.is_open()) {
+        routeScheduleStream.open(routeScheduleFile, std::ios::binary | std::ios::trunc);
+        if (!routeScheduleStream)
+            throw cRuntimeError("Cannot open route schedule '%s' for writing", routeScheduleFile.c_str());
+        uint32_t version = 1, numNodes = topology.getNumNodes();
+        routeScheduleStream.write("HPRS", 4);
+        routeScheduleStream.write((const char *)&version, sizeof(version));
+        routeScheduleStream.write((const char *)&numNodes, sizeof(numNodes));
+        for (int i = 0; i < topology.getNumNodes(); i++) {
+            std::string path = topology.getNode(i)->getModule()->getFullPath();
+            uint32_t pathLength = path.size();
+            routeScheduleStream.write((const char *)&pathLength, sizeof(pathLength));
+            routeScheduleStream.write(path.data(), pathLength);
+            scheduleNodeIndexByModuleId[topology.getNode(i)->getModule()->getId()] = i;
+        }
+        recordedRoutes.resize(numNodes);
+    }
+    std::vector<uint32_t> changedNodes;
+    for (int i = 0; i < topology.getNumNodes(); i++) {
+        Node *node = (Node *)topology.getNode(i);
+        auto it = scheduleNodeIndexByModuleId.find(node->getModule()->getId());
+        if (it == scheduleNodeIndexByModuleId.end() || node->routingTable == nullptr)
+            continue;
+        std::vector<ScheduledRoute> routes;
+        for (int j = 0; j < node->routingTable->getNumRoutes(); j++) {
+            Ipv4Route *route = node->routingTable->getRoute(j);
+            if (route->getSource() == this)
+                routes.push_back({route->getDestination().getInt(), route->getNetmask().getInt(), route->getGateway().getInt(), route->getInterface() != nullptr ? route->getInterface()->getInterfaceId() : -1, route->getMetric()});
+        }
+        std::sort(routes.begin(), routes.end());
+        if (routes != recordedRoutes[it->second]) {
+            recordedRoutes[it->second].swap(routes);
+            changedNodes.push_back(it->second);
+        }
+    }
+    if (changedNodes.empty() && numRecordedEpochs > 0)
+        return;
+    double time = simTime().dbl();
+    uint32_t numChangedNodes = changedNodes.size();
+    routeScheduleStream.write((const char *)&time, sizeof(time));
+    routeScheduleStream.write((const char *)&numChangedNodes, sizeof(numChangedNodes));
+    for (uint32_t nodeIndex : changedNodes) {
+        uint32_t numRoutes = recordedRoutes[nodeIndex].size();
+        routeScheduleStream.write((const char *)&nodeIndex, sizeof(nodeIndex));
+        routeScheduleStream.write((const char *)&numRoutes, sizeof(numRoutes));
+        routeScheduleStream.write((const char *)recordedRoutes[nodeIndex].data(), numRoutes * sizeof(ScheduledRoute));
+    }
+    numRecordedEpochs++;
+}
+
+/**
+ * Replaces the static routes of the nodes listed in the epoch with the recorded ones. They are installed by
+ * configureRoutingTable(Node *) afterwards, which only touches the routes that differ.
+ */
+void Ipv4NetworkConfiguratorUpdate::replayRouteScheduleEpoch(size_t epoch, std::vector<Node *>& changedNodes)
+{
+    size_t offset = epochOffsets[epoch] + sizeof(double);
+    uint32_t numChangedNodes;
+    memcpy(&numChangedNodes, routeSchedule + offset, sizeof(numChangedNodes));
+    offset += sizeof(numChangedNodes);
+    for (uint32_t i = 0; i < numChangedNodes; i++) {
+        uint32_t nodeIndex, numRoutes;
+        memcpy(&nodeIndex, routeSchedule + offset, sizeof(nodeIndex));
+        memcpy(&numRoutes, routeSchedule + offset + sizeof(nodeIndex), sizeof(numRoutes));
+        offset += sizeof(nodeIndex) + sizeof(numRoutes);
+        Node *node = scheduleNodes[nodeIndex];
+        std::for_each(node->staticRoutes.begin(), node->staticRoutes.end(), []( Ipv4Route* route) { delete route; });
+        node->staticRoutes.clear();
+        for (uint32_t j = 0; j < numRoutes; j++, offset += sizeof(ScheduledRoute)) {
+            ScheduledRoute scheduledRoute;
+            memcpy(&scheduledRoute, routeSchedule + offset, sizeof(scheduledRoute));
+            NetworkInterface *networkInterface = nullptr;
+            if (scheduledRoute.interfaceId != -1 && (networkInterface = node->interfaceTable->getInterfaceById(scheduledRoute.interfaceId)) == nullptr)
+                throw cRuntimeError("Route schedule '%s' refers to an unknown interface of %s", routeScheduleFile.c_str(), node->getModule()->getFullPath().c_str());
+            Ipv4Route *route = new Ipv4Route();
+            route->setSourceType(IRoute::MANUAL);
+            route->setDestination(Ipv4Address(scheduledRoute.destination));
+            route->setNetmask(Ipv4Address(scheduledRoute.netmask));
+            route->setGateway(Ipv4Address(scheduledRoute.gateway));
+            route->setInterface(networkInterface);
+            route->setMetric(scheduledRoute.metric);
+            node->staticRoutes.push_back(route);
+        }
+        if (!contains(changedNodes, node))
+            changedNodes.push_back(node);
+    }
+}
+
+/**
+ * In replay mode, resolves the nodes of the schedule file on first use and loads every epoch that is already due
+ * (the one recorded at time zero) into the static routes.
+ */
+void Ipv4NetworkConfiguratorUpdate::ensureRouteScheduleReplayed()
+{
+    if (routeScheduleMode != ROUTE_SCHEDULE_REPLAY || !scheduleNodes.empty())
+        return;
+    std::map<std::string, Node *> nodesByPath;
+    for (int i = 0; i < topology.getNumNodes(); i++)
+        nodesByPath[topology.getNode(i)->getModule()->getFullPath()] = (Node *)topology.getNode(i);
+    for (auto& path : scheduleNodePaths) {
+        auto it = nodesByPath.find(path);
+        if (it == nodesByPath.end())
+            throw cRuntimeError("Route schedule '%s' was recorded for a different network, %s not found", routeScheduleFile.c_str(), path.c_str());
+        scheduleNodes.push_back(it->second);
+    }
+    std::vector<Node *> changedNodes;
+    while (nextEpoch < epochTimes.size() && epochTimes[nextEpoch] <= simTime())
+        replayRouteScheduleEpoch(nextEpoch++, changedNodes);
+}
+
+/**
+ * Returns the hook registered on the Ipv4 module of the node, registering a new one on first use. Returns nullptr
+ * if the node has no Ipv4 module at the usual place.
+ */
+EcmpForwardingHook *Ipv4NetworkConfiguratorUpdate::getEcmpHook(Node *node)
+{
+    int moduleId = node->getModule()->getId();
+    auto it = ecmpHooks.find(moduleId);
+    if (it != ecmpHooks.end())
+        return it->second;
+    EcmpForwardingHook *hook = nullptr;
+    if (auto netfilter = dynamic_cast<INetfilter *>(node->getModule()->findModuleByPath(".ipv4.ip"))) {
+        hook = new EcmpForwardingHook(moduleId * 2654435761u);
+        if (flowletSwitching)
+            hook->setFlowletSwitching(flowletTimeout, utilizationTimeConstant);
+        netfilter->registerHook(0, hook);
+    }
+    ecmpHooks[moduleId] = hook;
+    return hook;
+}
+
+cXMLElement *Ipv4NetworkConfiguratorUpdate::getFirstAutorouteElement(cXMLElement& defaultAutorouteElement)
+{
+    cXMLElementList autorouteElements = configuration->getChildrenByTagName("autoroute");
+    return autorouteElements.empty() ? &defaultAutorouteElement : autorouteElements[0];
 }
 
 /**
@@ -175,6 +1234,8 @@ void Ipv4NetworkConfiguratorUpdate::reinvokeConfigurator(Topology& topology, cXM
 void Ipv4NetworkConfiguratorUpdate::configureAllRoutingTables()
 {
     ensureConfigurationComputed(topology);
+    ensureShortestPathTreesComputed();
+    ensureRouteScheduleReplayed();
     EV_INFO << "Configuring all routing tables.\n";
     for (int i = 0; i < topology.getNumNodes(); i++) {
         Node *node = (Node *)topology.getNode(i);
@@ -191,6 +1252,8 @@ void Ipv4NetworkConfiguratorUpdate::configureAllRoutingTables()
 void Ipv4NetworkConfiguratorUpdate::configureRoutingTable(IIpv4RoutingTable *routingTable)
 {
     ensureConfigurationComputed(topology);
+    ensureShortestPathTreesComputed();
+    ensureRouteScheduleReplayed();
     // TODO: avoid linear search
     for (int i = 0; i < topology.getNumNodes(); i++) {
         Node *node = (Node *)topology.getNode(i);
@@ -202,37 +1265,54 @@ void Ipv4NetworkConfiguratorUpdate::configureRoutingTable(IIpv4RoutingTable *rou
 
 /**
  * Overriden method from the IPv4 Configurator. As the routing tables will need to be configured multiple times,
- * routes may appear twice unless they are removed. This method will make sure that duplicated routes within the tables
- * are disregarded/replaced accordingly.
+ * the routes this configurator installed earlier are indexed by destination and netmask and brought in line with
+ * the new static routes: matching routes are updated in place, missing ones are added and stale ones deleted.
+ * Routes from other sources are left alone.
  */
 void Ipv4NetworkConfiguratorUpdate::configureRoutingTable(Node *node)
 {
     EV_DETAIL << "Configuring routing table of " << node->getModule()->getFullPath() << ".\n";
+    RouteIndex installedRoutes;
+    if (!incrementalUpdate) // otherwise our routes come from installRoutesTowards() and there are no static routes
+        indexRoutes(node->routingTable, installedRoutes);
+    int numAdded = 0, numUpdated = 0, numDeleted = 0;
     for (size_t i = 0; i < node->staticRoutes.size(); i++) {
         Ipv4Route *original = node->staticRoutes[i];
-        Ipv4Route *clone = new Ipv4Route();
-        if(i < node->staticRoutes.size()){
-            bool dupe = false;
-            for (int j = 0; j < node->routingTable->getNumRoutes(); j++){
-                if(original->getDestinationAsGeneric() == node->routingTable->getRoute(j)->getDestinationAsGeneric()){
-                    node->routingTable->getRoute(j)->setNextHop(original->getNextHopAsGeneric()); //If the destination is already in the routing table, the destination will be updated with the new found better hop.
-                    dupe = true;
-                    delete clone;
-                }
-            }
-            if(dupe != true){ //If no duplication occurs, the link can be added as usual. Otherwise it is ignored.
-                clone->setMetric(original->getMetric());
-                clone->setSourceType(original->getSourceType());
-                clone->setSource(original->getSource());
-                clone->setDestination(original->getDestination());
-                clone->setNetmask(original->getNetmask());
-                clone->setGateway(original->getGateway());
-                clone->setInterface(original->getInterface());
-                node->routingTable->addRoute(clone);
+        auto it = installedRoutes.find(getRouteKey(original));
+        if (it != installedRoutes.end()) {
+            Ipv4Route *route = it->second;
+            if (route == nullptr) // already handled, first static route for the same destination wins
+                continue;
+            if (route->getGateway() != original->getGateway() || route->getInterface() != original->getInterface() || route->getMetric() != original->getMetric()) {
+                route->setGateway(original->getGateway());
+                route->setInterface(original->getInterface());
+                route->setMetric(original->getMetric());
+                numUpdated++;
             }
-
+            it->second = nullptr;
+        }
+        else {
+            Ipv4Route *clone = new Ipv4Route();
+            clone->setMetric(original->getMetric());
+            clone->setSourceType(original->getSourceType());
+            clone->setSource(this);
+            clone->setDestination(original->getDestination());
+            clone->setNetmask(original->getNetmask());
+            clone->setGateway(original->getGateway());
+            clone->setInterface(original->getInterface());
+            node->routingTable->addRoute(clone);
+            installedRoutes[getRouteKey(clone)] = nullptr;
+            numAdded++;
         }
     }
+    for (auto& entry : installedRoutes) {
+        if (entry.second != nullptr) {
+            node->routingTable->deleteRoute(entry.second);
+            numDeleted++;
+        }
+    }
+    EV_DETAIL << numAdded << " routes added, " << numUpdated << " updated, " << numDeleted << " deleted.\n";
+    routeIndexes.erase(node->getModule()->getId()); // rebuilt by the next installRoute()
     /**
      * Multicast route implementation that is not used for the simulation model. This was implemented in case
      * future experiments require it.
@@ -252,6 +1332,35 @@ void Ipv4NetworkConfiguratorUpdate::configureRoutingTable(Node *node)
         node->routingTable->addMulticastRoute(clone);
     }
 }
+
+/**
+ * Collects the routes of the table that this configurator installed.
+ */
+void Ipv4NetworkConfiguratorUpdate::indexRoutes(IIpv4RoutingTable *routingTable, RouteIndex& routeIndex)
+{
+    routeIndex.clear();
+    routeIndex.reserve(routingTable->getNumRoutes());
+    for (int i = 0; i < routingTable->getNumRoutes(); i++) {
+        Ipv4Route *route = routingTable->getRoute(i);
+        if (route->getSource() == this)
+            routeIndex[getRouteKey(route)] = route;
+    }
+}
+
+/**
+ * The index of the routes this configurator owns in the node's routing table, built from the table on first use.
+ */
+Ipv4NetworkConfiguratorUpdate::RouteIndex& Ipv4NetworkConfiguratorUpdate::getRouteIndex(Node *node)
+{
+    int moduleId = node->getModule()->getId();
+    auto it = routeIndexes.find(moduleId);
+    if (it != routeIndexes.end())
+        return it->second;
+    RouteIndex& routeIndex = routeIndexes[moduleId];
+    indexRoutes(node->routingTable, routeIndex);
+    return routeIndex;
+}
+
 /**
  * This method is needed for use within the computeWirelessWeight method.
  */
@@ -268,4 +1377,4 @@ static double parseCostAttribute(const char *costAttribute)
 }
 
 
-}
+}
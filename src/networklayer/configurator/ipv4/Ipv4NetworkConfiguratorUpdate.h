@@ -13,33 +13,207 @@
 // along with this program.  If not, see http://www.gnu.org/licenses/.
 // 
 
-#ifndef HPCC_IPV4NETWORKCONFIGURATORUPDATE_H_
+#ifndef HPCC_IPV4NETWORKCONFIGURATORUPDATE_H_
 #define HPCC_IPV4NETWORKCONFIGURATORUPDATE_H_
 
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
 #include "inet/networklayer/configurator/ipv4/Ipv4NetworkConfigurator.h"
-#include "inet/networklayer/configurator/base/NetworkConfiguratorBase.h"
+#include "inet/networklayer/configurator/base/NetworkConfiguratorBase.h"
 #include "inet/common/packet/chunk/ByteCountChunk.h"
+#include "../../ipv4/EcmpForwardingHook.h"
 
 namespace inet {
 
-class Ipv4NetworkConfiguratorUpdate : public Ipv4NetworkConfigurator{
+class Ipv4NetworkConfiguratorUpdate : public Ipv4NetworkConfigurator, public cListener{
     public:
         virtual void reinvokeConfigurator(Topology& topology, cXMLElement *autorouteElement);
+        virtual void reinvokeConfiguratorIncrementally(Topology& topology, cXMLElement *autorouteElement);
         void configureRoutingTable(Node *node);
         virtual void configureAllRoutingTables() override;
         virtual void configureRoutingTable(IIpv4RoutingTable *routingTable) override;
-        virtual ~Ipv4NetworkConfiguratorUpdate(){};
+        virtual ~Ipv4NetworkConfiguratorUpdate();
     protected:
+        /**
+         * Identifies a link by the output gate of the network node it leaves from: (module id, gate id).
+         */
+        typedef std::pair<int, int> GateKey;
+
+        /**
+         * State of one output gate of a network node. Two snapshots that compare equal produce the same routes.
+         */
+        struct GateState {
+            int remoteModuleId = -1;
+            double delay = 0;
+            double datarate = 0;
+            bool disabled = false;
+            double load = 0; // applied utilization, see updateLinkLoads()
+            bool operator==(const GateState& other) const { return remoteModuleId == other.remoteModuleId && delay == other.delay && datarate == other.datarate && disabled == other.disabled && load == other.load; }
+            bool operator!=(const GateState& other) const { return !(*this == other); }
+        };
+        typedef std::map<GateKey, GateState> TopologySnapshot;
+
+        /**
+         * Compact copy of the extracted topology Dijkstra runs on. Nodes are ordered by module id and the
+         * edges are grouped by the node they lead into, so shortest path trees can be grown from a destination.
+         */
+        struct RoutingGraph {
+            struct Edge {
+                int from;
+                int to;
+                double weight;
+                GateKey gate;
+                Link *link;
+            };
+            std::vector<Node *> nodes;
+            std::vector<int> moduleIds;
+            std::map<int, int> nodeIndexByModuleId;
+            std::vector<bool> forwarding;
+            std::vector<Edge> edges;
+            std::vector<int> inEdgeOffsets;
+            std::vector<int> outEdges; // edge indices grouped by the node they leave from
+            std::vector<int> outEdgeOffsets;
+            std::map<GateKey, int> edgeIndexByGate;
+        };
+
+        /**
+         * Shortest path tree towards one destination node. For every node it stores the distance and the
+         * output gate of the next hop, which stay valid when the topology is extracted again. With ecmp, the
+         * gates of further next hops with the same distance are kept in alternativeNextHopGates.
+         */
+        struct ShortestPathTree {
+            int destination = -1;
+            std::vector<double> distances;
+            std::vector<GateKey> nextHopGates;
+            std::vector<std::vector<GateKey>> alternativeNextHopGates;
+        };
+
+        /**
+         * Routes owned by this configurator in one routing table, keyed by getRouteKey().
+         */
+        typedef std::unordered_map<uint64_t, Ipv4Route *> RouteIndex;
+
+        /**
+         * One route of the binary route schedule, see recordRouteScheduleEpoch() for the file layout.
+         */
+        struct ScheduledRoute {
+            uint32_t destination;
+            uint32_t netmask;
+            uint32_t gateway;
+            int32_t interfaceId;
+            int32_t metric;
+            bool operator==(const ScheduledRoute& other) const { return destination == other.destination && netmask == other.netmask && gateway == other.gateway && interfaceId == other.interfaceId && metric == other.metric; }
+            bool operator<(const ScheduledRoute& other) const { return destination != other.destination ? destination < other.destination : netmask < other.netmask; }
+        };
+        enum RouteScheduleMode { ROUTE_SCHEDULE_OFF, ROUTE_SCHEDULE_RECORD, ROUTE_SCHEDULE_REPLAY };
+
+        /**
+         * Utilization of a link measured from the IntQueue of its source interface.
+         */
+        struct LinkLoad {
+            long lastTxBytes = 0;
+            simtime_t lastUpdate;
+            double utilization = 0; // EWMA over reconfigurations
+            double appliedUtilization = 0; // what the link weight uses, only follows utilization beyond congestionHysteresis
+        };
+
         simtime_t timerInterval;
         cMessage * timer = nullptr;
+
+        bool reconfigureOnTopologyChange = false;
+        simtime_t reconfigurationHoldDown;
+        long numTopologyChangeNotifications = 0;
+        long numReconfigurations = 0;
+
+        RouteScheduleMode routeScheduleMode = ROUTE_SCHEDULE_OFF;
+        std::string routeScheduleFile;
+        std::ofstream routeScheduleStream; // record
+        std::map<int, uint32_t> scheduleNodeIndexByModuleId; // record
+        std::vector<std::vector<ScheduledRoute>> recordedRoutes; // record, last recorded routes per node
+        long numRecordedEpochs = 0;
+        const char *routeSchedule = nullptr; // replay, the mapped file
+        size_t routeScheduleSize = 0;
+        std::vector<char> routeScheduleBuffer; // replay, holds the file where mmap is not available
+        std::vector<std::string> scheduleNodePaths; // replay
+        std::vector<Node *> scheduleNodes; // replay, by node index of the file
+        std::vector<size_t> epochOffsets; // replay
+        std::vector<simtime_t> epochTimes; // replay
+        size_t nextEpoch = 0; // replay
+
+        std::string configurationCacheFile;
+
+        double congestionWeight = 0;
+        double congestionSmoothing = 0;
+        double congestionHysteresis = 0;
+        std::map<GateKey, LinkLoad> linkLoads;
+
+        bool incrementalUpdate = false;
+        unsigned int numRoutingThreads = 1;
+        bool ecmp = false;
+        bool flowletSwitching = false;
+        simtime_t flowletTimeout;
+        simtime_t utilizationTimeConstant;
+        std::map<int, EcmpForwardingHook *> ecmpHooks; // by node module id
+        std::map<int, RouteIndex> routeIndexes; // by node module id, the routes installRoute() maintains
+        bool fastReroute = false;
+        simtime_t failureDetectionTime;
+        cMessage *failureDetectionTimer = nullptr;
+        std::multimap<simtime_t, GateKey> pendingFailures; // by detection time
+        std::map<GateKey, std::pair<int, int>> interfaceIdsByGate; // (node module id, interface id) of every gate seen in a RoutingGraph
+        TopologySnapshot topologySnapshot;
+        std::vector<int> treeModuleIds;
+        std::vector<ShortestPathTree> shortestPathTrees;
+
         virtual void handleMessage(cMessage *msg) override;
         virtual void initialize(int stage) override;
+        virtual void finish() override;
+        virtual void receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details) override;
+        virtual bool isTopologyChange(cObject *notification);
+        virtual void reconfigure();
+        virtual void updateLinkLoads();
+        virtual double computeLinkWeight(Link *link, const char *metric, cXMLElement *parameters) override;
+
+        virtual void computeConfiguration() override;
+        virtual uint64_t computeConfigurationKey();
+        virtual bool loadConfigurationCache(uint64_t key);
+        virtual void saveConfigurationCache(uint64_t key);
+
+        virtual void openRouteSchedule();
+        virtual void closeRouteSchedule();
+        virtual void recordRouteScheduleEpoch();
+        virtual void replayRouteScheduleEpoch(size_t epoch, std::vector<Node *>& changedNodes);
+        virtual void ensureRouteScheduleReplayed();
+
+        virtual void clearTopology(Topology& topology);
+        virtual void takeTopologySnapshot(Topology& topology, TopologySnapshot& snapshot);
+        virtual void buildRoutingGraph(Topology& topology, cXMLElement *autorouteElement, RoutingGraph& graph);
+        virtual void computeShortestPathTree(const RoutingGraph& graph, int destination, ShortestPathTree& tree);
+        virtual void computeShortestPathTrees(const RoutingGraph& graph, const std::vector<int>& destinations);
+        virtual bool isShortestPathTreeAffected(const RoutingGraph& graph, const ShortestPathTree& tree, const std::set<GateKey>& changedGates);
+        virtual void installRoutesTowards(const RoutingGraph& graph, const ShortestPathTree& tree);
+        virtual void installBackupNextHopsTowards(const RoutingGraph& graph, const ShortestPathTree& tree);
+        virtual void setInterfaceFailed(const GateKey& gate, bool failed);
+        virtual void installRoute(Node *node, Ipv4Address destination, Ipv4Address gateway, NetworkInterface *networkInterface);
+        virtual void ensureShortestPathTreesComputed();
+        virtual cXMLElement *getFirstAutorouteElement(cXMLElement& defaultAutorouteElement);
+
+        virtual EcmpForwardingHook *getEcmpHook(Node *node);
+        static bool isEqualCost(double distance1, double distance2) { return std::abs(distance1 - distance2) <= 1E-9 * std::max(distance1, distance2); }
+
+        static uint64_t getRouteKey(const Ipv4Route *route) { return ((uint64_t)route->getDestination().getInt() << 32) | route->getNetmask().getInt(); }
+        virtual void indexRoutes(IIpv4RoutingTable *routingTable, RouteIndex& routeIndex);
+        virtual RouteIndex& getRouteIndex(Node *node);
 
 
         //virtual void extractTopology(Topology& topology);
 
 
-
-};
-}
-#endif /* OS3_NETWORKLAYER_CONFIGURATOR_IPV4_SATELLITENETWORKCONFIGURATOR_H_ */
+
+};
+}
+#endif /* OS3_NETWORKLAYER_CONFIGURATOR_IPV4_SATELLITENETWORKCONFIGURATOR_H_ */
@@ -0,0 +1,217 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include "EcmpForwardingHook.h"
+
+#include <algorithm>
+
+#include "inet/networklayer/common/IpProtocolId_m.h"
+#include "inet/networklayer/common/InterfaceTag_m.h"
+#include "inet/networklayer/common/NextHopAddressTag_m.h"
+#include "inet/networklayer/ipv4/Ipv4Header_m.h"
+#include "inet/transportlayer/tcp_common/TcpHeader_m.h"
+#include "inet/transportlayer/udp/UdpHeader_m.h"
+
+namespace inet {
+
+void EcmpForwardingHook::setNextHops(Ipv4Address destination, const std::vector<NextHop>& nextHops)
+{
+    if (nextHops.size() < 2)
+        nextHopsByDestination.erase(destination.getInt());
+    else
+        nextHopsByDestination[destination.getInt()] = nextHops;
+}
+
+const std::vector<EcmpForwardingHook::NextHop> *EcmpForwardingHook::findNextHops(Ipv4Address destination) const
+{
+    auto it = nextHopsByDestination.find(destination.getInt());
+    return it == nextHopsByDestination.end() ? nullptr : &it->second;
+}
+
+/**
+ * FNV-1a over source and destination address, protocol and ports, seeded per node so that consecutive
+ * hops do not make correlated choices (hash polarization).
+ */
+uint32_t EcmpForwardingHook::computeFlowHash(const Packet *datagram) const
+{
+    const auto& ipv4Header = datagram->peekAtFront<Ipv4Header>();
+    uint32_t ports = 0;
+    if (ipv4Header->getFragmentOffset() == 0) {
+        if (ipv4Header->getProtocolId() == IP_PROT_TCP) {
+            const auto& tcpHeader = datagram->peekDataAt<tcp::TcpHeader>(ipv4Header->getChunkLength());
+            ports = (tcpHeader->getSrcPort() << 16) | tcpHeader->getDestPort();
+        }
+        else if (ipv4Header->getProtocolId() == IP_PROT_UDP) {
+            const auto& udpHeader = datagram->peekDataAt<UdpHeader>(ipv4Header->getChunkLength());
+            ports = (udpHeader->getSrcPort() << 16) | udpHeader->getDestPort();
+        }
+    }
+    uint32_t words[] = { ipv4Header->getSrcAddress().getInt(), ipv4Header->getDestAddress().getInt(), (uint32_t)ipv4Header->getProtocolId(), ports };
+    uint32_t hash = 2166136261u ^ hashSeed;
+    for (uint32_t word : words) {
+        for (int i = 0; i < 4; i++) {
+            hash ^= (word >> (8 * i)) & 0xff;
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+INetfilter::IHook::Result EcmpForwardingHook::selectNextHop(Packet *datagram)
+{
+    if (nextHopsByDestination.empty() && failedInterfaceIds.empty())
+        return ACCEPT;
+    const auto& ipv4Header = datagram->peekAtFront<Ipv4Header>();
+    uint32_t destination = ipv4Header->getDestAddress().getInt();
+    NextHop nextHop = { -1, Ipv4Address::UNSPECIFIED_ADDRESS };
+    auto it = nextHopsByDestination.find(destination);
+    if (it != nextHopsByDestination.end()) {
+        if (failedInterfaceIds.empty())
+            nextHop = selectEqualCostNextHop(datagram, it->second);
+        else {
+            std::vector<NextHop> nextHops;
+            for (auto& candidate : it->second) {
+                if (failedInterfaceIds.count(candidate.interfaceId) == 0)
+                    nextHops.push_back(candidate);
+            }
+            if (!nextHops.empty())
+                nextHop = selectEqualCostNextHop(datagram, nextHops);
+        }
+    }
+    if (nextHop.interfaceId == -1 && !failedInterfaceIds.empty()) {
+        // all equal-cost next hops or the routed one failed
+        auto jt = backupsByDestination.find(destination);
+        if (jt != backupsByDestination.end() && failedInterfaceIds.count(jt->second.primaryInterfaceId) != 0 && failedInterfaceIds.count(jt->second.nextHop.interfaceId) == 0) {
+            nextHop = jt->second.nextHop;
+            numReroutedPackets++;
+        }
+    }
+    if (nextHop.interfaceId != -1) {
+        datagram->addTagIfAbsent<InterfaceReq>()->setInterfaceId(nextHop.interfaceId);
+        datagram->addTagIfAbsent<NextHopAddressReq>()->setNextHopAddress(nextHop.gateway);
+    }
+    return ACCEPT;
+}
+
+EcmpForwardingHook::NextHop EcmpForwardingHook::selectEqualCostNextHop(Packet *datagram, const std::vector<NextHop>& nextHops)
+{
+    uint32_t flowHash = computeFlowHash(datagram);
+    const NextHop *nextHop = &nextHops[flowHash % nextHops.size()];
+    if (flowletSwitching) {
+        Flowlet& flowlet = flowlets[flowHash];
+        auto it = std::find_if(nextHops.begin(), nextHops.end(), [&] (const NextHop& candidate) { return candidate.interfaceId == flowlet.interfaceId; });
+        if (it != nextHops.end() && simTime() - flowlet.lastSeen < flowletTimeout)
+            nextHop = &*it;
+        else {
+            nextHop = &selectLeastCongestedNextHop(nextHops);
+            if (flowlet.interfaceId != -1 && flowlet.interfaceId != nextHop->interfaceId)
+                numFlowletSwitches++;
+            flowlet.interfaceId = nextHop->interfaceId;
+            numFlowlets++;
+        }
+        flowlet.lastSeen = simTime();
+        if (flowlets.size() > flowletPurgeSize)
+            purgeFlowlets();
+    }
+    return *nextHop;
+}
+
+void EcmpForwardingHook::setBackupNextHop(Ipv4Address destination, int primaryInterfaceId, const NextHop& backupNextHop)
+{
+    if (backupNextHop.interfaceId == -1)
+        backupsByDestination.erase(destination.getInt());
+    else
+        backupsByDestination[destination.getInt()] = { primaryInterfaceId, backupNextHop };
+}
+
+void EcmpForwardingHook::setInterfaceFailed(int interfaceId, bool failed)
+{
+    if (failed)
+        failedInterfaceIds.insert(interfaceId);
+    else
+        failedInterfaceIds.erase(interfaceId);
+}
+
+void EcmpForwardingHook::setFlowletSwitching(simtime_t flowletTimeout, simtime_t utilizationTimeConstant)
+{
+    flowletSwitching = true;
+    this->flowletTimeout = flowletTimeout;
+    this->utilizationTimeConstant = utilizationTimeConstant;
+}
+
+void EcmpForwardingHook::setEgress(int interfaceId, queueing::IntQueue *queue, double datarate)
+{
+    Egress& egress = egresses[interfaceId];
+    if (egress.queue != queue) {
+        egress.queue = queue;
+        egress.lastTxBytes = queue != nullptr ? queue->getTxBytes() : 0;
+        egress.lastUpdate = simTime();
+        egress.utilization = 0;
+    }
+    egress.datarate = datarate;
+}
+
+const EcmpForwardingHook::NextHop& EcmpForwardingHook::selectLeastCongestedNextHop(const std::vector<NextHop>& nextHops)
+{
+    const NextHop *best = &nextHops[0];
+    double bestCongestion = getCongestion(best->interfaceId);
+    for (size_t i = 1; i < nextHops.size(); i++) {
+        double congestion = getCongestion(nextHops[i].interfaceId);
+        if (congestion < bestCongestion) {
+            best = &nextHops[i];
+            bestCongestion = congestion;
+        }
+    }
+    return *best;
+}
+
+/**
+ * Utilization in the sense of HPCC's U: txRate / B + qLen / (B * T), with T = utilizationTimeConstant.
+ */
+double EcmpForwardingHook::getCongestion(int interfaceId)
+{
+    auto it = egresses.find(interfaceId);
+    if (it == egresses.end() || it->second.queue == nullptr || it->second.datarate <= 0)
+        return 0;
+    Egress& egress = it->second;
+    simtime_t now = simTime();
+    if (now > egress.lastUpdate) {
+        double interval = (now - egress.lastUpdate).dbl();
+        double txRate = (egress.queue->getTxBytes() - egress.lastTxBytes) * 8 / interval;
+        double weight = std::min(1.0, interval / utilizationTimeConstant.dbl());
+        egress.utilization = (1 - weight) * egress.utilization + weight * txRate / egress.datarate;
+        egress.lastTxBytes = egress.queue->getTxBytes();
+        egress.lastUpdate = now;
+    }
+    return egress.utilization + egress.queue->getTotalLength().get() / (egress.datarate * utilizationTimeConstant.dbl());
+}
+
+/**
+ * Drops flowlets that have timed out. The threshold for the next purge doubles with the number of live flowlets,
+ * so purging stays amortized constant per packet.
+ */
+void EcmpForwardingHook::purgeFlowlets()
+{
+    simtime_t now = simTime();
+    for (auto it = flowlets.begin(); it != flowlets.end(); ) {
+        if (now - it->second.lastSeen >= flowletTimeout)
+            it = flowlets.erase(it);
+        else
+            ++it;
+    }
+    flowletPurgeSize = std::max((size_t)1024, 2 * flowlets.size());
+}
+
+}
@@ -0,0 +1,126 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef NETWORKLAYER_IPV4_ECMPFORWARDINGHOOK_H_
+#define NETWORKLAYER_IPV4_ECMPFORWARDINGHOOK_H_
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "inet/networklayer/contract/INetfilter.h"
+#include "inet/networklayer/contract/ipv4/Ipv4Address.h"
+#include "../../queueing/queue/IntQueue.h"
+
+namespace inet {
+
+/**
+ * Spreads the flows towards a destination over its equal-cost next hops. The hook is registered on the Ipv4
+ * module of a node by Ipv4NetworkConfiguratorUpdate, which keeps the next hops up to date. A flow is identified
+ * by its 5-tuple, so all segments of a connection take the same path. For destinations without alternatives the
+ * datagram is left to the routing table.
+ *
+ * With flowlet switching, a flow keeps its next hop only while its packets are less than flowletTimeout apart.
+ * The first packet after a longer gap starts a new flowlet, which is sent to the least congested next hop. As
+ * the gap exceeds the difference in path delays, this does not reorder packets. Congestion of an egress is
+ * judged from its IntQueue like HPCC does: the tx rate (averaged over utilizationTimeConstant) relative to the
+ * link capacity, plus the time needed to drain the queue relative to utilizationTimeConstant.
+ *
+ * For fast reroute, the hook also knows a loop-free alternate next hop for destinations. Once an interface is
+ * marked as failed, it is no longer used for ECMP, and datagrams whose routed next hop uses it are sent to the
+ * backup instead, until the configurator has computed new routes.
+ */
+class EcmpForwardingHook : public NetfilterBase::HookBase
+{
+  public:
+    struct NextHop {
+        int interfaceId;
+        Ipv4Address gateway;
+    };
+
+  protected:
+    struct Egress {
+        queueing::IntQueue *queue = nullptr;
+        double datarate = 0;
+        long lastTxBytes = 0;
+        simtime_t lastUpdate;
+        double utilization = 0;
+    };
+    struct Flowlet {
+        int interfaceId = -1;
+        simtime_t lastSeen;
+    };
+
+    struct Backup {
+        int primaryInterfaceId;
+        NextHop nextHop;
+    };
+
+    uint32_t hashSeed;
+    std::unordered_map<uint32_t, std::vector<NextHop>> nextHopsByDestination;
+    std::unordered_map<uint32_t, Backup> backupsByDestination;
+    std::unordered_set<int> failedInterfaceIds;
+    long numReroutedPackets = 0;
+
+    bool flowletSwitching = false;
+    simtime_t flowletTimeout;
+    simtime_t utilizationTimeConstant;
+    std::unordered_map<int, Egress> egresses; // by interface id
+    std::unordered_map<uint32_t, Flowlet> flowlets; // by flow hash
+    size_t flowletPurgeSize = 1024;
+    long numFlowlets = 0;
+    long numFlowletSwitches = 0;
+
+    virtual Result selectNextHop(Packet *datagram);
+    virtual NextHop selectEqualCostNextHop(Packet *datagram, const std::vector<NextHop>& nextHops);
+    virtual const NextHop& selectLeastCongestedNextHop(const std::vector<NextHop>& nextHops);
+    virtual double getCongestion(int interfaceId);
+    virtual void purgeFlowlets();
+
+  public:
+    EcmpForwardingHook(uint32_t hashSeed) : hashSeed(hashSeed) {}
+
+    /**
+     * Sets the next hops used for the destination. Less than two next hops removes the destination.
+     */
+    virtual void setNextHops(Ipv4Address destination, const std::vector<NextHop>& nextHops);
+    virtual const std::vector<NextHop> *findNextHops(Ipv4Address destination) const;
+    virtual uint32_t computeFlowHash(const Packet *datagram) const;
+
+    virtual void setFlowletSwitching(simtime_t flowletTimeout, simtime_t utilizationTimeConstant);
+    /**
+     * Tells the hook where to read the congestion of an egress interface. Interfaces without IntQueue count as idle.
+     */
+    virtual void setEgress(int interfaceId, queueing::IntQueue *queue, double datarate);
+
+    /**
+     * Sets the backup next hop used for the destination while primaryInterfaceId has failed, or removes it if
+     * the backup's interfaceId is -1.
+     */
+    virtual void setBackupNextHop(Ipv4Address destination, int primaryInterfaceId, const NextHop& backupNextHop);
+    virtual void setInterfaceFailed(int interfaceId, bool failed);
+    long getNumReroutedPackets() const { return numReroutedPackets; }
+    long getNumFlowlets() const { return numFlowlets; }
+    long getNumFlowletSwitches() const { return numFlowletSwitches; }
+
+    virtual Result datagramPreRoutingHook(Packet *datagram) override { return selectNextHop(datagram); }
+    virtual Result datagramForwardHook(Packet *datagram) override { return ACCEPT; }
+    virtual Result datagramPostRoutingHook(Packet *datagram) override { return ACCEPT; }
+    virtual Result datagramLocalInHook(Packet *datagram) override { return ACCEPT; }
+    virtual Result datagramLocalOutHook(Packet *datagram) override { return selectNextHop(datagram); }
+};
+
+}
+
+#endif /* NETWORKLAYER_IPV4_ECMPFORWARDINGHOOK_H_ */
@@ -17,8 +17,10 @@
 #include <inet/transportlayer/tcp_common/TcpHeader_m.h>
 #include <inet/common/PacketEventTag.h>
 #include <inet/common/TimeTag.h>
+#include <inet/common/packet/chunk/ByteCountChunk.h>
 #include <inet/networklayer/common/NetworkInterface.h>
 #include "../../common/IntTag_m.h"
+#include "../../common/LogHistogram.h"
 #include "IntQueue.h"
 
 namespace inet {
@@ -34,9 +36,37 @@ void IntQueue::initialize(int stage)
     txBytes = 0;
     sumRttByCwnd = 0;
     sumRttSquareByCwnd = 0;
+    sumOfFlowWeights = 0;
+    prevSumOfFlowWeights = 0;
     avgRtt = 0;
     avgRttTimer = SimTime(10, SIMTIME_MS);
-    if (stage == INITSTAGE_TRANSPORT_LAYER) {
+    if (stage == INITSTAGE_LOCAL) {
+        accountIntHeaderBytes = par("accountIntHeaderBytes");
+        intBaseHeaderLength = B(par("intBaseHeaderLength").intValue());
+        intHopMetadataLength = B(par("intHopMetadataLength").intValue());
+        recordQueueHistograms = par("recordQueueHistograms");
+        if (recordQueueHistograms) {
+            initializeLogHistogram(occupancyHistogram, "queueOccupancy", 64, 1E9); // bytes
+            initializeLogHistogram(sojournTimeHistogram, "queueSojournTime", 1E-7, 10); // seconds
+            initializeLogHistogram(uPrimeHistogram, "uPrime", 1E-3, 1E3);
+        }
+        lastTimerTxBytes = 0;
+        lastTimerTime = 0;
+        prioritizeControlPackets = par("prioritizeControlPackets");
+        stampAcks = par("stampAcks");
+        exactFlowTable = par("exactFlowTable");
+        flowTableCapacity = par("flowTableCapacity");
+        flowTableTimeout = par("flowTableTimeout");
+        flowTableSumRtt = 0;
+        flowTableSumRttSquare = 0;
+        flowTableSumWeights = 0;
+        controlQueue.setName("controlQueue");
+        numControlPackets = 0;
+        numControlPacketsAheadOfData = 0;
+        WATCH(numControlPackets);
+        WATCH(numControlPacketsAheadOfData);
+    }
+    else if (stage == INITSTAGE_TRANSPORT_LAYER) {
         averageRttTimerMsg = new cMessage("averageRttTimerMsg");
         averageRttTimerMsg->setContextPointer(this);
         scheduleTimer();
@@ -49,6 +79,15 @@ void IntQueue::finish()
         cancelEvent(averageRttTimerMsg);
     }
     delete averageRttTimerMsg;
+    if (prioritizeControlPackets) {
+        recordScalar("controlPackets", numControlPackets);
+        recordScalar("controlPacketsAheadOfData", numControlPacketsAheadOfData);
+    }
+    if (recordQueueHistograms) {
+        recordLogHistogram(this, occupancyHistogram, occupancyHistogram.getName());
+        recordLogHistogram(this, sojournTimeHistogram, sojournTimeHistogram.getName());
+        recordLogHistogram(this, uPrimeHistogram, uPrimeHistogram.getName());
+    }
 }
 
 void IntQueue::handleMessage(cMessage *message)
@@ -64,14 +103,31 @@ void IntQueue::handleMessage(cMessage *message)
 
 void IntQueue::processTimer()
 {
-    if(sumRttSquareByCwnd > 0 && sumRttByCwnd > 0){
+    if (recordQueueHistograms && avgRtt > 0 && simTime() > lastTimerTime) {
+        // u' of this hop as a sender would derive it from two consecutive INT samples
+        double bandwidth = dynamic_cast<NetworkInterface*>(getParentModule())->getRxTransmissionChannel()->getNominalDatarate()/8;
+        double txRate = (txBytes - lastTimerTxBytes)/(simTime() - lastTimerTime).dbl();
+        uPrimeHistogram.collect(B(getTotalLength()).get()/(bandwidth*avgRtt.dbl()) + txRate/bandwidth);
+    }
+    lastTimerTxBytes = txBytes;
+    lastTimerTime = simTime();
+    if(exactFlowTable){
+        expireFlowTable();
+        if(flowTableSumRttSquare > 0 && flowTableSumRtt > 0){
+            avgRtt = SimTime(flowTableSumRttSquare/flowTableSumRtt);
+            cSimpleModule::emit(avgRttSignal, avgRtt);
+        }
+    }
+    else if(sumRttSquareByCwnd > 0 && sumRttByCwnd > 0){
         avgRtt = SimTime(sumRttSquareByCwnd/sumRttByCwnd);
         sumRttSquareByCwnd = 0;
         sumRttByCwnd = 0;
         if(flowIds.size() > 0){
             prevSharingFlows = flowIds.size();
+            prevSumOfFlowWeights = sumOfFlowWeights;
         }
         flowIds.clear();
+        sumOfFlowWeights = 0;
         cSimpleModule::emit(avgRttSignal, avgRtt);
     }
     scheduleTimer();
@@ -87,6 +143,42 @@ void IntQueue::scheduleTimer()
     }
 }
 
+int IntQueue::getNumPackets() const
+{
+    return PacketQueue::getNumPackets() + controlQueue.getLength();
+}
+
+b IntQueue::getTotalLength() const
+{
+    return PacketQueue::getTotalLength() + b(controlQueue.getBitLength());
+}
+
+Packet *IntQueue::getPacket(int index) const
+{
+    // The control lane is served first, so it logically sits in front of the data packets
+    if (index < controlQueue.getLength())
+        return check_and_cast<Packet *>(controlQueue.get(index));
+    return PacketQueue::getPacket(index - controlQueue.getLength());
+}
+
+void IntQueue::removePacket(Packet *packet)
+{
+    if (controlQueue.contains(packet)) {
+        Enter_Method("removePacket");
+        EV_INFO << "Removing packet" << EV_FIELD(packet) << EV_ENDL;
+        controlQueue.remove(packet);
+        updateDisplayString();
+    }
+    else
+        PacketQueue::removePacket(packet);
+}
+
+bool IntQueue::isControlPacket(Packet *packet, const Ptr<const tcp::TcpHeader>& tcpHeader) const
+{
+    B shimLength = tcpHeader->findTag<IntTag>() ? tcpHeader->getTag<IntTag>()->getShimLength() : B(0);
+    return packet->getDataLength() - shimLength == b(0) || tcpHeader->getSynBit() || tcpHeader->getFinBit();
+}
+
 void IntQueue::pushPacket(Packet *packet, cGate *gate)
 {
     Enter_Method("pushPacket");
@@ -99,26 +191,44 @@ void IntQueue::pushPacket(Packet *packet, cGate *gate)
     if (ipv4Header->getTotalLengthField() < packet->getDataLength())
     packet->setBackOffset(B(ipv4Header->getTotalLengthField()) - ipv4Header->getChunkLength());
     auto tcpHeader = packet->removeAtFront<tcp::TcpHeader>();
-    if(tcpHeader->findTag<IntTag>()){
+    if(exactFlowTable){
+        if(tcpHeader->findTag<IntTag>() && tcpHeader->getTag<IntTag>()->getCwnd() > 0){ //ACKs carry no cwnd
+            updateFlowTable(tcpHeader->getTag<IntTag>()->getConnId(), tcpHeader->getTag<IntTag>()->getRtt(), tcpHeader->getTag<IntTag>()->getWeight());
+        }
+    }
+    else if(tcpHeader->findTag<IntTag>()){
         if(tcpHeader->getTag<IntTag>()->getRtt().dbl() > 0 && tcpHeader->getTag<IntTag>()->getCwnd() > 0){
             sumRttByCwnd += tcpHeader->getTag<IntTag>()->getRtt().dbl() * 1460 / tcpHeader->getTag<IntTag>()->getCwnd();
             sumRttSquareByCwnd += tcpHeader->getTag<IntTag>()->getRtt().dbl() * tcpHeader->getTag<IntTag>()->getRtt().dbl() * 1460 / tcpHeader->getTag<IntTag>()->getCwnd();
         }
-        flowIds.insert(tcpHeader->getTag<IntTag>()->getConnId());
+        if(flowIds.insert(tcpHeader->getTag<IntTag>()->getConnId()).second){
+            sumOfFlowWeights += tcpHeader->getTag<IntTag>()->getWeight();
+        }
         //std::cout << "\n INT QUEUE CWND: " << tcpHeader->getTag<IntTag>()->getCwnd() << endl;
     }
+    bool controlPacket = prioritizeControlPackets && isControlPacket(packet, tcpHeader);
     packet->insertAtFront(tcpHeader);
     ipv4Header->setTotalLengthField(ipv4Header->getChunkLength() + packet->getDataLength());
     packet->insertAtFront(ipv4Header);
 
-    queue.insert(packet);
+    if (recordQueueHistograms)
+        occupancyHistogram.collect(B(getTotalLength()).get());
+    if (controlPacket) {
+        controlQueue.insert(packet);
+        numControlPackets++;
+    }
+    else
+        queue.insert(packet);
     if (buffer != nullptr)
         buffer->addPacket(packet);
     else if (packetDropperFunction != nullptr) {
         while (isOverloaded()) {
             auto packet = packetDropperFunction->selectPacket(this);
             EV_INFO << "Dropping packet" << EV_FIELD(packet) << EV_ENDL;
-            queue.remove(packet);
+            if (controlQueue.contains(packet))
+                controlQueue.remove(packet);
+            else
+                queue.remove(packet);
             dropPacket(packet, QUEUE_OVERFLOW);
         }
     }
@@ -130,33 +240,133 @@ void IntQueue::pushPacket(Packet *packet, cGate *gate)
     updateDisplayString();
 }
 
+void IntQueue::updateFlowTable(long connId, simtime_t rtt, double weight)
+{
+    // Every flow contributes its latest sample exactly once, however many packets it sent. No 1460/cwnd weight as
+    // in the per packet estimator, there it only cancels that a flow's number of samples grows with its cwnd
+    auto it = flowTable.find(connId);
+    if(it != flowTable.end()){
+        flowTableSumRtt -= it->second->rtt;
+        flowTableSumRttSquare -= it->second->rttSquare;
+        flowTableSumWeights -= it->second->weight;
+        flowList.splice(flowList.begin(), flowList, it->second);
+    }
+    else{
+        flowList.push_front(FlowEntry());
+        flowList.front().connId = connId;
+        flowTable[connId] = flowList.begin();
+    }
+    FlowEntry& entry = flowList.front();
+    entry.rtt = rtt.dbl();
+    entry.rttSquare = rtt.dbl() * rtt.dbl();
+    entry.weight = weight;
+    entry.lastSeen = simTime();
+    flowTableSumRtt += entry.rtt;
+    flowTableSumRttSquare += entry.rttSquare;
+    flowTableSumWeights += weight;
+    expireFlowTable();
+}
+
+void IntQueue::expireFlowTable()
+{
+    simtime_t timeout = flowTableTimeout > 0 ? flowTableTimeout : 2 * avgRttTimer;
+    while(!flowList.empty() && ((int) flowList.size() > flowTableCapacity || flowList.back().lastSeen < simTime() - timeout)){
+        flowTableSumRtt -= flowList.back().rtt;
+        flowTableSumRttSquare -= flowList.back().rttSquare;
+        flowTableSumWeights -= flowList.back().weight;
+        flowTable.erase(flowList.back().connId);
+        flowList.pop_back();
+    }
+    if(flowList.empty()){ //drop accumulated rounding errors
+        flowTableSumRtt = 0;
+        flowTableSumRttSquare = 0;
+        flowTableSumWeights = 0;
+    }
+}
+
+void IntQueue::fillIntMetaData(IntMetaData *intData)
+{
+    if(exactFlowTable){
+        expireFlowTable();
+        if(flowTableSumRttSquare > 0 && flowTableSumRtt > 0){
+            intData->setAverageRtt(flowTableSumRttSquare/flowTableSumRtt);
+        }
+        else{
+            intData->setAverageRtt(avgRtt.dbl());
+        }
+        if(flowTable.size() > 0){
+            prevSharingFlows = flowTable.size();
+            prevSumOfFlowWeights = flowTableSumWeights;
+        }
+        intData->setNumOfFlows(prevSharingFlows);
+        intData->setSumOfWeights(prevSumOfFlowWeights);
+    }
+    else{
+        intData->setAverageRtt(avgRtt.dbl());
+
+        if(flowIds.size() > 0){
+            intData->setNumOfFlows(flowIds.size());
+            intData->setSumOfWeights(sumOfFlowWeights);
+        }
+        else{
+            intData->setNumOfFlows(prevSharingFlows);
+            intData->setSumOfWeights(prevSumOfFlowWeights);
+        }
+    }
+    intData->setHopName(getParentModule()->getParentModule()->getFullName());
+    // backlog of both lanes, control packets queued ahead of data delay it just the same
+    intData->setQLen(B(getTotalLength()).get());
+    //std::cout << "\n Queue length in bytes: " << queue.getByteLength() << endl;
+    intData->setTs(simTime());
+    intData->setTxBytes(txBytes);
+    intData->setB(dynamic_cast<NetworkInterface*>(getParentModule())->getRxTransmissionChannel()->getNominalDatarate()/8);
+}
+
+void IntQueue::appendIntHeaderBytes(Packet *packet, const Ptr<tcp::TcpHeader>& tcpHeader)
+{
+    // The first stamping hop also pushes the INT base header, every hop appends its own metadata record
+    B shimLength = tcpHeader->addTagIfAbsent<IntTag>()->getShimLength();
+    B hopLength = shimLength == B(0) ? intBaseHeaderLength + intHopMetadataLength : intHopMetadataLength;
+    tcpHeader->addTagIfAbsent<IntTag>()->setShimLength(shimLength + hopLength);
+    packet->insertAtBack(makeShared<ByteCountChunk>(hopLength));
+    txBytes += hopLength.get();
+}
+
 Packet *IntQueue::pullPacket(cGate *gate)
 {
     Enter_Method("pullPacket");
-    auto packet = check_and_cast<Packet *>(queue.front());
+    cPacketQueue& lane = controlQueue.isEmpty() ? queue : controlQueue;
+    if (&lane == &controlQueue && !queue.isEmpty())
+        numControlPacketsAheadOfData++;
+    auto packet = check_and_cast<Packet *>(lane.front());
     EV_INFO << "Pulling packet" << EV_FIELD(packet) << EV_ENDL;
     if (buffer != nullptr) {
-        queue.remove(packet);
+        lane.remove(packet);
         buffer->removePacket(packet);
     }
     else
-        queue.pop();
+        lane.pop();
     auto queueingTime = simTime() - packet->getArrivalTime();
     auto packetEvent = new PacketQueuedEvent();
     packetEvent->setQueuePacketLength(getNumPackets());
     packetEvent->setQueueDataLength(getTotalLength());
     insertPacketEvent(this, packet, PEK_QUEUED, queueingTime, packetEvent);
     increaseTimeTag<QueueingTimeTag>(packet, queueingTime, queueingTime);
+    if (recordQueueHistograms)
+        sojournTimeHistogram.collect(queueingTime);
 
     auto ipv4Header = packet->removeAtFront<Ipv4Header>();
     if (ipv4Header->getTotalLengthField() < packet->getDataLength())
         packet->setBackOffset(B(ipv4Header->getTotalLengthField()) - ipv4Header->getChunkLength());
     auto tcpHeader = packet->removeAtFront<tcp::TcpHeader>();
     txBytes += packet->getByteLength();
-    if(packet->getDataLength() > b(0)) { //Data Packet
+    B shimLength = tcpHeader->findTag<IntTag>() ? tcpHeader->getTag<IntTag>()->getShimLength() : B(0);
+    if(packet->getDataLength() - shimLength > b(0)) { //Data Packet
         //std::cout << "\n pullPacket - " << getParentModule()->getParentModule()->getFullName() << endl;
         //std::cout << "\n Bandwidth: " << dynamic_cast<NetworkInterface*>(getParentModule())->getTxTransmissionChannel()->getNominalDatarate()/8 << endl;
         tcpHeader->addTagIfAbsent<IntTag>();
+        if (accountIntHeaderBytes)
+            appendIntHeaderBytes(packet, tcpHeader);
         
         IntMetaData* intData = new IntMetaData();
 //        if(tcpHeader->findTag<IntTag>()){
@@ -185,20 +395,7 @@ Packet *IntQueue::pullPacket(cGate *gate)
 //            //std::cout << "\n Average RTT at INT queue: " << averageRtt << endl;
 //            intData->setAverageRtt(averageRtt);
 //        }
-        intData->setAverageRtt(avgRtt.dbl());
-
-        if(flowIds.size() > 0){
-            intData->setNumOfFlows(flowIds.size());
-        }
-        else{
-            intData->setNumOfFlows(prevSharingFlows);
-        }
-        intData->setHopName(getParentModule()->getParentModule()->getFullName());
-        intData->setQLen(queue.getByteLength());
-        //std::cout << "\n Queue length in bytes: " << queue.getByteLength() << endl;
-        intData->setTs(simTime());
-        intData->setTxBytes(txBytes);
-        intData->setB(dynamic_cast<NetworkInterface*>(getParentModule())->getRxTransmissionChannel()->getNominalDatarate()/8);
+        fillIntMetaData(intData);
         //std::cout << "\n Module full name: " << dynamic_cast<NetworkInterface*>(getParentModule())->getParentModule()->getClassAndFullName() << endl;
         //std::cout << "\n PPP full name: " << dynamic_cast<NetworkInterface*>(getParentModule())->getClassAndFullName() << endl;
         //std::cout << "\n Datarate: " << dynamic_cast<NetworkInterface*>(getParentModule())->getTxTransmissionChannel()->getNominalDatarate() << endl;
@@ -206,6 +403,13 @@ Packet *IntQueue::pullPacket(cGate *gate)
         tcpHeader->addTagIfAbsent<IntTag>()->getIntDataForUpdate().push_back(intData);
         //tcpHeader->addTagIfAbsent<IntTag>()->getIntDataForUpdate().push_bac
     }
+    else if (stampAcks) { //ACK, reverse path telemetry is kept apart from the forward path data it echoes
+        if (accountIntHeaderBytes)
+            appendIntHeaderBytes(packet, tcpHeader);
+        IntMetaData* intData = new IntMetaData();
+        fillIntMetaData(intData);
+        tcpHeader->addTagIfAbsent<IntTag>()->getReverseIntDataForUpdate().push_back(intData);
+    }
     packet->insertAtFront(tcpHeader);
     ipv4Header->setTotalLengthField(ipv4Header->getChunkLength() + packet->getDataLength());
     packet->insertAtFront(ipv4Header);
@@ -16,8 +16,12 @@
 #ifndef QUEUEING_QUEUE_INTQUEUE_H_
 #define QUEUEING_QUEUE_INTQUEUE_H_
 
+#include <list>
 #include <map>
+#include <unordered_map>
 #include "inet/queueing/queue/PacketQueue.h"
+#include "inet/transportlayer/tcp_common/TcpHeader_m.h"
+#include "../../common/IntTag_m.h"
 
 namespace inet {
 namespace queueing {
@@ -33,9 +37,48 @@ protected:
     //std::map<std::string, simtime_t> rtts;
     std::set<long> flowIds;
     int prevSharingFlows;
+    double sumOfFlowWeights; // of the flows in flowIds
+    double prevSumOfFlowWeights;
     double sumRttByCwnd;
     double sumRttSquareByCwnd;
 
+    bool accountIntHeaderBytes;
+    B intBaseHeaderLength;
+    B intHopMetadataLength;
+
+    // Log-bucketed distributions recorded at finish() instead of per change vectors
+    bool recordQueueHistograms;
+    cHistogram occupancyHistogram;
+    cHistogram sojournTimeHistogram;
+    cHistogram uPrimeHistogram;
+    long lastTimerTxBytes;
+    simtime_t lastTimerTime;
+
+    // Strict priority lane for pure ACKs and SYN/FIN segments, always dequeued before data
+    bool prioritizeControlPackets;
+    cPacketQueue controlQueue;
+    long numControlPackets;
+    long numControlPacketsAheadOfData;
+
+    bool stampAcks;
+
+    // Exact mode: latest rtt per flow, most recently seen first, aged out after flowTableTimeout
+    struct FlowEntry {
+        long connId;
+        double rtt;
+        double rttSquare;
+        double weight;
+        simtime_t lastSeen;
+    };
+    bool exactFlowTable;
+    int flowTableCapacity;
+    simtime_t flowTableTimeout;
+    std::list<FlowEntry> flowList;
+    std::unordered_map<long, std::list<FlowEntry>::iterator> flowTable;
+    double flowTableSumRtt;
+    double flowTableSumRttSquare;
+    double flowTableSumWeights;
+
 protected:
     virtual void initialize(int stage) override;
     virtual void handleMessage(cMessage *message) override;
@@ -43,7 +86,19 @@ protected:
     virtual void scheduleTimer();
 
     virtual void finish() override;
+    virtual bool isControlPacket(Packet *packet, const Ptr<const tcp::TcpHeader>& tcpHeader) const;
+    virtual void fillIntMetaData(IntMetaData *intData);
+    virtual void updateFlowTable(long connId, simtime_t rtt, double weight);
+    virtual void expireFlowTable();
+    virtual void appendIntHeaderBytes(Packet *packet, const Ptr<tcp::TcpHeader>& tcpHeader);
 public:
+    long getTxBytes() const { return txBytes; }
+
+    virtual int getNumPackets() const override;
+    virtual b getTotalLength() const override;
+    virtual Packet *getPacket(int index) const override;
+    virtual void removePacket(Packet *packet) override;
+
     virtual void pushPacket(Packet *packet, cGate *gate) override;
     virtual Packet *pullPacket(cGate *gate) override;
 };
@@ -13,6 +13,8 @@
 // along with this program.  If not, see http://www.gnu.org/licenses/.
 // 
 
+#include <inet/common/ProtocolTag_m.h>
+#include "../../common/IntTag_m.h"
 #include "Hpcc.h"
 #include "HpccSendQueue.h"
 
@@ -40,6 +42,17 @@ TcpConnection* Hpcc::createConnection(int socketId)
     return module;
 }
 
+void Hpcc::handleLowerPacket(Packet *packet)
+{
+    // INT header bytes appended by IntQueue only exist on the wire, they are not part of the segment text
+    if (packet->getTag<PacketProtocolTag>()->getProtocol() == &Protocol::tcp) {
+        const auto& tcpHeader = packet->peekAtFront<TcpHeader>();
+        if (tcpHeader->findTag<IntTag>() && tcpHeader->getTag<IntTag>()->getShimLength() > B(0))
+            packet->popAtBack(tcpHeader->getTag<IntTag>()->getShimLength());
+    }
+    Tcp::handleLowerPacket(packet);
+}
+
 TcpSendQueue *Hpcc::createSendQueue()
 {
     return new HpccSendQueue();
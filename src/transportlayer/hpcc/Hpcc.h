@@ -29,6 +29,7 @@ public:
 protected:
     /** Factory method; may be overriden for customizing Tcp */
     virtual TcpConnection* createConnection(int socketId) override;
+    virtual void handleLowerPacket(Packet *packet) override;
 public:
     virtual TcpSendQueue *createSendQueue() override;
 };
@@ -18,6 +18,7 @@
 #include <inet/transportlayer/tcp/TcpReceiveQueue.h>
 #include <inet/transportlayer/tcp/TcpSackRexmitQueue.h>
 
+#include "../../common/DeadlineTag_m.h"
 #include "flavours/HpccFlavour.h"
 #include "HpccConnection.h"
 namespace inet {
@@ -114,6 +115,9 @@ void HpccConnection::process_SEND(TcpEventCode& event, TcpCommand *tcpCommand, c
     // FIXME how to support PUSH? One option is to treat each SEND as a unit of data,
     // and set PSH at SEND boundaries
     Packet *packet = check_and_cast<Packet *>(msg);
+    simtime_t deadline = -1;
+    for (auto& region : packet->peekData()->getAllTags<DeadlineTag>())
+        deadline = std::max(deadline, region.getTag()->getDeadline());
     switch (fsm.getState()) {
         case TCP_S_INIT:
             throw cRuntimeError(tcpMain, "Error processing command SEND: connection not open");
@@ -152,6 +156,10 @@ void HpccConnection::process_SEND(TcpEventCode& event, TcpCommand *tcpCommand, c
             throw cRuntimeError(tcpMain, "Error processing command SEND: connection closing");
     }
 
+    // the deadline covers everything queued so far
+    if (deadline >= SIMTIME_ZERO)
+        dynamic_cast<HpccFlavour*>(tcpAlgorithm)->setDeadline(deadline, sendQueue->getBufferEndSeq());
+
     if ((state->sendQueueLimit > 0) && (sendQueue->getBytesAvailable(state->snd_una) > state->sendQueueLimit))
         state->queueUpdate = false;
 }
@@ -889,6 +897,9 @@ bool HpccConnection::processAckInEstabEtc(Packet *tcpSegment, const Ptr<const Tc
             //std::cout << "Packet info: " << tcpHeader->str() << endl;
 
             if(tcpHeader->findTag<IntTag>()){
+                if(!tcpHeader->getTag<IntTag>()->getReverseIntData().empty()){
+                    dynamic_cast<HpccFlavour*>(tcpAlgorithm)->receivedReverseInt(tcpHeader->getTag<IntTag>()->getReverseIntData());
+                }
                 IntDataVec intDataNew = tcpHeader->getTag<IntTag>()->getIntData();
                 dynamic_cast<HpccFlavour*>(tcpAlgorithm)->receivedDataAckInt(old_snd_una, tcpHeader->getTag<IntTag>()->getIntData());
             }
@@ -1128,6 +1139,7 @@ uint32_t HpccConnection::sendSegment(uint32_t bytes)
     tcpHeader->addTagIfAbsent<IntTag>()->setConnId((unsigned long)dynamic_cast<HpccFlavour*>(tcpAlgorithm)->getConnId());
     tcpHeader->addTagIfAbsent<IntTag>()->setRtt(dynamic_cast<HpccFlavour*>(tcpAlgorithm)->getRtt());
     tcpHeader->addTagIfAbsent<IntTag>()->setCwnd(dynamic_cast<HpccFlavour*>(tcpAlgorithm)->getCwnd());
+    tcpHeader->addTagIfAbsent<IntTag>()->setWeight(dynamic_cast<HpccFlavour*>(tcpAlgorithm)->getWeight());
     // send it
     sendToIP(tcpSegment, tcpHeader);
 
@@ -7,6 +7,7 @@
 #include "HpccFlavour.h"
 
 #include <algorithm> // min,max
+#include <cmath>
 
 #include "inet/transportlayer/tcp/Tcp.h"
 
@@ -24,6 +25,9 @@ simsignal_t HpccFlavour::uSignal = cComponent::registerSignal("u");
 simsignal_t HpccFlavour::USignal = cComponent::registerSignal("U");
 simsignal_t HpccFlavour::additiveIncreaseSignal = cComponent::registerSignal("additiveIncrease");
 simsignal_t HpccFlavour::sharingFlowsSignal = cComponent::registerSignal("sharingFlows");
+simsignal_t HpccFlavour::reverseUSignal = cComponent::registerSignal("reverseU");
+simsignal_t HpccFlavour::reverseQueueingDelaySignal = cComponent::registerSignal("reverseQueueingDelay");
+simsignal_t HpccFlavour::deadlineUrgencySignal = cComponent::registerSignal("deadlineUrgency");
 
 HpccFlavour::HpccFlavour() : TcpReno(),
     state((HpccStateVariables *&)TcpAlgorithm::state)
@@ -36,9 +40,18 @@ void HpccFlavour::initialize()
     state->B = conn->getTcpMain()->par("bandwidth");
     state->subFlows = conn->getTcpMain()->par("subFlows");
     state->sharingFlows = conn->getTcpMain()->par("sharingFlows");
+    state->weight = conn->getTcpMain()->par("weight");
+    if (state->weight <= 0)
+        throw cRuntimeError("weight must be positive");
+    state->sharingWeight = state->sharingFlows; //until the first INT sample, assume the other flows have weight 1
+    state->deadlineAware = conn->getTcpMain()->par("deadlineAware");
+    state->maxDeadlineUrgency = conn->getTcpMain()->par("maxDeadlineUrgency");
+    if (state->maxDeadlineUrgency < 1)
+        throw cRuntimeError("maxDeadlineUrgency must be at least 1");
     state->additiveIncreasePercent = conn->getTcpMain()->par("additiveIncreasePercent");
     state->eta = state->eta/state->subFlows;
     state->T = conn->getTcpMain()->par("basePropagationRTT");
+    state->compensateReversePathDelay = conn->getTcpMain()->par("compensateReversePathDelay");
     state->u = 0;
     //TODO add Par for number of N. Currently is 10 meaning 10 flows. Look at paper for wAI
     //state->additiveIncrease = ((state->B * state->T.dbl())*(1-state->eta))/state->sharingFlows;
@@ -283,6 +296,8 @@ double HpccFlavour::measureInflight(IntDataVec intData)
                     u = uPrime;
                     tau = intDataEntry->getTs().dbl() - state->L.at(i)->getTs().dbl();
                     state->sharingFlows = intDataEntry->getNumOfFlows();
+                    //switches that do not report weights count every flow as 1
+                    state->sharingWeight = intDataEntry->getSumOfWeights() > 0 ? intDataEntry->getSumOfWeights() : state->sharingFlows;
                     bottleneckAverageRtt = intDataEntry->getAverageRtt();
                     if(bottleneckAverageRtt <= 0){
                         bottleneckAverageRtt = state->srtt.dbl();
@@ -329,28 +344,78 @@ double HpccFlavour::measureInflight(IntDataVec intData)
     state->u = (1-(tau/bottleneckAverageRtt))*state->u+(tau/bottleneckAverageRtt)*u;
     conn->emit(USignal, state->u);
 
-    state->additiveIncrease = ((bottleneckBandwidth * state->srtt.dbl())*(state->additiveIncreasePercent))/state->sharingFlows;
-    dynamic_cast<HpccConnection*>(conn)->changeIntersendingTime(state->srtt.dbl()/((double) state->snd_cwnd/1460));
+    //weighted shares: the increase of all flows still adds up to additiveIncreasePercent of the BDP, split by weight
+    state->additiveIncrease = ((bottleneckBandwidth * state->srtt.dbl())*(state->additiveIncreasePercent))*state->weight/std::max(state->sharingWeight, state->weight);
+    dynamic_cast<HpccConnection*>(conn)->changeIntersendingTime(getPacingRtt().dbl()/((double) state->snd_cwnd/1460));
 
     conn->emit(additiveIncreaseSignal, state->additiveIncrease);
 
     return state->u;
 }
 
+void HpccFlavour::receivedReverseInt(IntDataVec reverseIntData)
+{
+    // Same per hop u' as measureInflight, but only observed: the window is driven by the data path alone
+    double u = 0;
+    simtime_t queueingDelay = 0;
+    for(int i = 0; i < reverseIntData.size(); i++){
+        IntMetaData* intDataEntry = reverseIntData.at(i);
+        queueingDelay += (double) intDataEntry->getQLen()/intDataEntry->getB();
+        if(state->reverseL.size() == reverseIntData.size()){
+            double interval = intDataEntry->getTs().dbl() - state->reverseL.at(i)->getTs().dbl();
+            double hopRtt = intDataEntry->getAverageRtt() > 0 ? intDataEntry->getAverageRtt() : state->srtt.dbl();
+            if(interval > 0 && hopRtt > 0){
+                double txRate = (intDataEntry->getTxBytes() - state->reverseL.at(i)->getTxBytes())/interval;
+                double uPrime = ((std::min(intDataEntry->getQLen(), state->reverseL.at(i)->getQLen()))/(intDataEntry->getB()*hopRtt))+(txRate/intDataEntry->getB());
+                if(uPrime > u) {
+                    u = uPrime;
+                }
+            }
+        }
+    }
+    state->reverseU = u;
+    state->reverseQueueingDelay = queueingDelay;
+    state->reverseL = reverseIntData;
+    conn->emit(reverseUSignal, state->reverseU);
+    conn->emit(reverseQueueingDelaySignal, state->reverseQueueingDelay);
+}
+
+simtime_t HpccFlavour::getPacingRtt()
+{
+    // Queueing on the ACK path inflates srtt without the data path being any slower, so leave it out of the pacing interval
+    if(!state->compensateReversePathDelay || state->reverseQueueingDelay <= 0){
+        return state->srtt;
+    }
+    simtime_t pacingRtt = state->srtt - state->reverseQueueingDelay;
+    return pacingRtt > state->T ? pacingRtt : std::min(state->srtt, state->T);
+}
+
 uint32_t HpccFlavour::computeWnd(double u, bool updateWc)
 {
     uint32_t w;
+    //D2TCP style: urgent flows (d > 1) back off less and grow faster, flows with slack (d < 1) yield to them.
+    //The aggregate decrease and increase then depend on the mix of urgencies, so the bottleneck queue may differ
+    //from plain HPCC; [Config Deadline] of Experiment2 records it for comparison
+    double d = computeDeadlineUrgency();
+    double additiveIncrease = state->additiveIncrease*d;
+    if(state->deadlineAware) {
+        conn->emit(deadlineUrgencySignal, d);
+    }
     //std::cout << "\n\n computeWnd..." << endl;
     //std::cout << "\n u value: " << u << endl;
     if(u >= state->eta || state->incStage >= state->maxStage) {
-        w = (state->prevWnd/(u/state->eta))+state->additiveIncrease;
+        double decrease = u/state->eta;
+        if(decrease > 1) {
+            decrease = std::pow(decrease, 1/d);
+        }
+        w = (state->prevWnd/decrease)+additiveIncrease;
         if(updateWc) {
             state->incStage = 0;
             state->prevWnd = w;
         }
     }
     else {
-        w = state->prevWnd + state->additiveIncrease;
+        w = state->prevWnd + additiveIncrease;
         //std::cout << "\n Updating with just additive increase " << state->additiveIncrease << " to " << w << " at sim time: " << simTime() << endl;
         if(updateWc) {
             state->incStage++;
@@ -380,6 +445,46 @@ unsigned int HpccFlavour::getCwnd()
     return state->snd_cwnd;
 }
 
+double HpccFlavour::getWeight()
+{
+    return state->weight;
+}
+
+void HpccFlavour::setDeadline(simtime_t deadline, uint32_t deadlineSeq)
+{
+    state->deadline = deadline;
+    state->deadlineSeq = deadlineSeq;
+}
+
+double HpccFlavour::computeDeadlineUrgency()
+{
+    if(!state->deadlineAware || state->deadline < SIMTIME_ZERO || !seqGreater(state->deadlineSeq, state->snd_una)) {
+        state->deadlineUrgency = 1;
+        return 1;
+    }
+    simtime_t timeLeft = state->deadline - simTime();
+    simtime_t rtt = state->srtt > 0 ? state->srtt : state->T;
+    if(timeLeft <= 0 || rtt <= 0 || state->snd_cwnd == 0) {
+        //a missed deadline gives no more priority, the flow falls back to plain HPCC
+        state->deadlineUrgency = 1;
+        return 1;
+    }
+    double rate = state->snd_cwnd/rtt.dbl();
+    double timeNeeded = (state->deadlineSeq - state->snd_una)/rate;
+    state->deadlineUrgency = std::max(1/state->maxDeadlineUrgency, std::min(timeNeeded/timeLeft.dbl(), state->maxDeadlineUrgency));
+    return state->deadlineUrgency;
+}
+
+double HpccFlavour::getReverseU()
+{
+    return state->reverseU;
+}
+
+simtime_t HpccFlavour::getReverseQueueingDelay()
+{
+    return state->reverseQueueingDelay;
+}
+
 } // namespace tcp
 } // namespace inet
 
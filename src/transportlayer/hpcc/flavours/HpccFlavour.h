@@ -43,6 +43,9 @@ class HpccFlavour : public TcpReno
     static simsignal_t USignal;
     static simsignal_t additiveIncreaseSignal;
     static simsignal_t sharingFlowsSignal;
+    static simsignal_t reverseUSignal;
+    static simsignal_t reverseQueueingDelaySignal;
+    static simsignal_t deadlineUrgencySignal;
 
     size_t connId;
     simtime_t rtt;
@@ -69,11 +72,21 @@ class HpccFlavour : public TcpReno
 
     virtual uint32_t computeWnd(double u, bool updateWc);
 
+    virtual double computeDeadlineUrgency();
+
     virtual double measureInflight(IntDataVec intData);
 
+    virtual void receivedReverseInt(IntDataVec reverseIntData);
+
+    virtual simtime_t getPacingRtt();
+
     virtual size_t getConnId();
     virtual simtime_t getRtt();
     virtual unsigned int getCwnd();
+    virtual double getWeight();
+    virtual void setDeadline(simtime_t deadline, uint32_t deadlineSeq);
+    virtual double getReverseU();
+    virtual simtime_t getReverseQueueingDelay();
 
 
     };